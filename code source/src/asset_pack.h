@@ -0,0 +1,149 @@
+#pragma once
+// Single-file archive of the window's images and sounds. The pack tool
+// (src/pack.cpp, `make assets.pak`) copies the files in byte for byte; the
+// window maps the archive once and decodes straight out of the mapping
+// instead of opening a dozen loose files next to the executable.
+//
+// Layout (little endian):
+//   "TRPK" | u32 version | u32 entry count | u32 reserved
+//   entry count x AssetPackEntry, sorted by name
+//   file contents, each starting on a 16-byte boundary
+//
+// Each entry carries a hash of its contents; Verify() checks them all.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+#include "snapshot.h"
+
+constexpr uint32_t ASSET_PACK_VERSION = 1;
+constexpr size_t ASSET_PACK_ALIGN = 16;
+constexpr size_t ASSET_NAME_LENGTH = 48;     // including the terminating zero
+
+struct AssetPackHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+};
+
+struct AssetPackEntry {
+    char name[ASSET_NAME_LENGTH];
+    uint64_t offset;
+    uint64_t size;
+    uint64_t hash;
+};
+
+// Name an asset is stored under: the file name without its directory
+inline const char* AssetName(const char* path) {
+    const char* name = path;
+    for (const char* p = path; *p; p++) if (*p == '/' || *p == '\\') name = p + 1;
+    return name;
+}
+
+class AssetPack {
+private:
+    MappedFile file;
+    const AssetPackEntry* entries = nullptr;
+    uint32_t count = 0;
+
+    bool Fail(std::string& error, const char* path, const char* what) {
+        error = std::string(path) + ": " + what;
+        Close();
+        return false;
+    }
+
+public:
+    bool Open(const char* path, std::string& error) {
+        Close();
+        if (!file.Open(path)) return Fail(error, path, "cannot read the file");
+        AssetPackHeader header;
+        if (file.Size() < sizeof(header)) return Fail(error, path, "not an asset pack");
+        memcpy(&header, file.Data(), sizeof(header));
+        if (memcmp(header.magic, "TRPK", 4) != 0) return Fail(error, path, "not an asset pack");
+        if (header.version != ASSET_PACK_VERSION) return Fail(error, path, "unsupported asset pack version");
+        if (sizeof(header) + sizeof(AssetPackEntry) * (size_t)header.entryCount > file.Size()) return Fail(error, path, "truncated entry table");
+        entries = (const AssetPackEntry*)(file.Data() + sizeof(header));
+        count = header.entryCount;
+        for (uint32_t k = 0; k < count; k++) {
+            const AssetPackEntry& e = entries[k];
+            if (e.name[ASSET_NAME_LENGTH - 1] != 0 || e.offset > file.Size() || e.size > file.Size() - e.offset) return Fail(error, path, "entry points outside the file");
+            if (k > 0 && strcmp(entries[k - 1].name, e.name) >= 0) return Fail(error, path, "entry table is not sorted");
+        }
+        return true;
+    }
+
+    void Close() {
+        file.Close();
+        entries = nullptr;
+        count = 0;
+    }
+
+    bool IsOpen() const { return file.IsOpen(); }
+    uint32_t Count() const { return count; }
+    const AssetPackEntry& Entry(uint32_t k) const { return entries[k]; }
+    size_t Bytes() const { return file.Size(); }
+
+    // Contents of an asset, pointing into the mapping; false if it is not in the pack
+    bool Find(const char* name, const uint8_t*& data, size_t& size) const {
+        const AssetPackEntry* end = entries + count;
+        const AssetPackEntry* e = std::lower_bound(entries, end, name, [](const AssetPackEntry& a, const char* n) { return strcmp(a.name, n) < 0; });
+        if (e == end || strcmp(e->name, name) != 0) return false;
+        data = file.Data() + e->offset;
+        size = (size_t)e->size;
+        return true;
+    }
+
+    // Name of the first asset whose contents do not match their hash, or nullptr
+    const char* Verify() const {
+        for (uint32_t k = 0; k < count; k++) {
+            if (SnapshotHash(file.Data() + entries[k].offset, (size_t)entries[k].size) != entries[k].hash) return entries[k].name;
+        }
+        return nullptr;
+    }
+};
+
+// Packs the given files into one archive at `path`. Every input is read
+// before the output is opened, so a missing file leaves no half-written pack.
+inline bool WriteAssetPack(const char* path, const std::vector<const char*>& inputs, std::string& error) {
+    std::vector<const char*> sorted(inputs);
+    std::sort(sorted.begin(), sorted.end(), [](const char* a, const char* b) { return strcmp(AssetName(a), AssetName(b)) < 0; });
+
+    std::vector<AssetPackEntry> entries(sorted.size());
+    std::vector<MappedFile> files(sorted.size());
+    uint64_t offset = sizeof(AssetPackHeader) + sizeof(AssetPackEntry) * sorted.size();
+    for (size_t k = 0; k < sorted.size(); k++) {
+        const char* name = AssetName(sorted[k]);
+        if (strlen(name) >= ASSET_NAME_LENGTH) { error = std::string(sorted[k]) + ": name is longer than " + std::to_string(ASSET_NAME_LENGTH - 1) + " characters"; return false; }
+        if (k > 0 && strcmp(AssetName(sorted[k - 1]), name) == 0) { error = std::string(name) + ": given twice"; return false; }
+        if (!files[k].Open(sorted[k])) { error = std::string(sorted[k]) + ": cannot read the file"; return false; }
+        AssetPackEntry& e = entries[k];
+        memset(&e, 0, sizeof(e));
+        memcpy(e.name, name, strlen(name));
+        offset = (offset + ASSET_PACK_ALIGN - 1) & ~(uint64_t)(ASSET_PACK_ALIGN - 1);
+        e.offset = offset;
+        e.size = files[k].Size();
+        e.hash = SnapshotHash(files[k].Data(), files[k].Size());
+        offset += e.size;
+    }
+
+    FILE* f = fopen(path, "wb");
+    if (!f) { error = std::string(path) + ": cannot create the file"; return false; }
+    AssetPackHeader header = { { 'T', 'R', 'P', 'K' }, ASSET_PACK_VERSION, (uint32_t)entries.size(), 0 };
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    if (!entries.empty()) ok = ok && fwrite(entries.data(), sizeof(AssetPackEntry), entries.size(), f) == entries.size();
+    uint64_t at = sizeof(header) + sizeof(AssetPackEntry) * entries.size();
+    const uint8_t zeros[ASSET_PACK_ALIGN] = { 0 };
+    for (size_t k = 0; k < entries.size() && ok; k++) {
+        ok = fwrite(zeros, 1, (size_t)(entries[k].offset - at), f) == entries[k].offset - at;
+        ok = ok && fwrite(files[k].Data(), 1, files[k].Size(), f) == files[k].Size();
+        at = entries[k].offset + entries[k].size;
+    }
+    if (fclose(f) != 0) ok = false;
+    if (!ok) { error = std::string(path) + ": write failed"; remove(path); }
+    return ok;
+}
@@ -0,0 +1,189 @@
+// Scaling benchmark for the traffic model. Fills every road to a fixed
+// density, runs a scenario headlessly and prints one JSON object per case,
+// one per line, so results can be diffed and plotted between builds.
+//
+//   bench [--ticks N] [--warmup N] [--seed N] [--threads N]
+//         [--vehicles N] [--scenario baseline|accident|emergency]
+//         [--config FILE] [--accidents N] [--no-simd] [--lod]
+//
+// Without --vehicles / --scenario every density (100, 1k, 10k, 100k) is
+// run with every scenario:
+//   baseline   normal traffic, accidents only from the model's own roll
+//   accident   an accident is forced (at most once a second) whenever fewer
+//              than the configured maximum are under way, and left standing
+//              so approaching cars keep swerving around it
+//   emergency  forced accidents plus the operator dispatching ambulances
+//              and tow trucks, and a school bus every 20 s
+//
+// ns_per_vehicle_update is wall time divided by the vehicles stepped over
+// all measured ticks. allocs_per_tick counts global operator new calls
+// during the measured ticks; it should read 0 once the pools and scratch
+// buffers have grown to the case. pool_high_water is the most vehicles the
+// roads held at once. Every road's pool is sized for its share of
+// --vehicles plus headroom for spawns. peak_rss_kb is the process high-water mark,
+// so cases run from small to large. --accidents overrides how many
+// accidents may be under way at once (accidents.maxConcurrent).
+// --lod turns on level of detail with the focus on the middle 1280 px of
+// the world, as the window's camera would see it; flow_vehicles counts the
+// cars left in the flow lanes at the end, and every car, in flow or not,
+// counts as one vehicle update per tick.
+// kinematics names the car kernel that ran; --no-simd forces the scalar
+// one, and state_hash must come out the same either way.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+#include "simulation.h"
+#include "operator.h"
+
+// --- ALLOCATION COUNTER ---
+static std::atomic<unsigned long long> allocationCount{ 0 };
+
+// Kept out of line, like the deletes below, so GCC does not see malloc()
+// and free() through the inlined operators and report a mismatch
+__attribute__((noinline)) void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { free(p); }
+
+static long PeakRssKb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+    return (long)(pmc.PeakWorkingSetSize / 1024);
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+#ifdef __APPLE__
+    return (long)(ru.ru_maxrss / 1024);
+#else
+    return (long)ru.ru_maxrss;
+#endif
+#endif
+}
+
+enum Scenario { SCENARIO_BASELINE, SCENARIO_ACCIDENT, SCENARIO_EMERGENCY, SCENARIO_COUNT };
+static const char* SCENARIO_NAMES[SCENARIO_COUNT] = { "baseline", "accident", "emergency" };
+
+struct BenchConfig {
+    long long ticks = 600;
+    long long warmup = 900;           // long enough for the queued cars to reach the screen
+    uint64_t seed = 1;
+    ThreadPool* pool = nullptr;
+    bool simd = true;
+    bool lod = false;
+    WorldConfig world;
+};
+
+// Commands a scenario sends before a tick
+static void Drive(Scenario scenario, Simulation& sim, Operator& op) {
+    if (scenario == SCENARIO_BASELINE) return;
+    bool everySecond = sim.GetTick() % TICKS_PER_SECOND == 0;
+    if (everySecond && sim.GetIncidents().Count() < (size_t)sim.GetConfig().maxAccidents) sim.Submit(CMD_TRIGGER_ACCIDENT);
+    if (scenario != SCENARIO_EMERGENCY) return;
+    op.Update(sim);
+    if (sim.GetTick() % (20 * TICKS_PER_SECOND) == 0) sim.Submit(CMD_CALL_SCHOOL_BUS);
+}
+
+// Room for a road's share of the population plus the cars spawned while it drains
+static const int SPAWN_HEADROOM = 1024;
+
+static void RunCase(const BenchConfig& cfg, Scenario scenario, int vehicles) {
+    WorldConfig world = cfg.world;
+    int roadCount = (int)world.roads.size();
+    world.roadCapacity = std::max(world.roadCapacity, (vehicles + roadCount - 1) / roadCount + SPAWN_HEADROOM);
+    Simulation sim(world);
+    sim.Init(cfg.seed);
+    sim.SetThreadPool(cfg.pool);
+    sim.SetSimd(cfg.simd);
+    sim.SetLevelOfDetail(cfg.lod);
+    sim.SetFocus(world.worldWidth / 2.0f - 640.0f, world.worldWidth / 2.0f + 640.0f);
+    sim.Populate(vehicles);
+    Operator op;
+
+    for (long long t = 0; t < cfg.warmup; t++) { Drive(scenario, sim, op); sim.Step(); }
+
+    unsigned long long allocsBefore = allocationCount.load();
+    unsigned long long vehicleUpdates = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (long long t = 0; t < cfg.ticks; t++) {
+        Drive(scenario, sim, op);
+        vehicleUpdates += sim.VehicleCount() + sim.FlowCount();
+        sim.Step();
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    unsigned long long allocs = allocationCount.load() - allocsBefore;
+    PoolStats pools = sim.GetPoolStats();
+
+    printf("{\"scenario\":\"%s\",\"vehicles\":%d,\"live_vehicles\":%zu,\"flow_vehicles\":%zu,\"threads\":%zu,\"kinematics\":\"%s\",\"ticks\":%lld,"
+           "\"ticks_per_s\":%.1f,\"ns_per_vehicle_update\":%.2f,\"allocs_per_tick\":%.3f,"
+           "\"pool_capacity\":%zu,\"pool_high_water\":%zu,\"peak_rss_kb\":%ld,\"accidents\":%lld,\"state_hash\":\"%016llx\"}\n",
+           SCENARIO_NAMES[scenario], vehicles, sim.VehicleCount() + sim.FlowCount(), sim.FlowCount(), cfg.pool ? cfg.pool->Size() : (size_t)1, sim.GetKinematicsPath(), cfg.ticks,
+           wall > 0.0 ? cfg.ticks / wall : 0.0,
+           vehicleUpdates ? wall * 1e9 / (double)vehicleUpdates : 0.0,
+           (double)allocs / (double)cfg.ticks,
+           pools.capacity, pools.highWater, PeakRssKb(), sim.GetStats().accidents, (unsigned long long)sim.StateHash());
+    fflush(stdout);
+}
+
+static void PrintUsage() {
+    printf("usage: bench [--ticks N] [--warmup N] [--seed N] [--threads N] [--vehicles N] [--scenario baseline|accident|emergency] [--config FILE] [--accidents N] [--no-simd] [--lod]\n");
+}
+
+int main(int argc, char** argv) {
+    BenchConfig cfg;
+    int threads = 1;
+    int onlyVehicles = 0;
+    int onlyScenario = -1;
+    const char* configPath = nullptr;
+    int maxAccidents = 0;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--ticks") == 0 && hasValue) cfg.ticks = atoll(argv[++i]);
+        else if (strcmp(argv[i], "--warmup") == 0 && hasValue) cfg.warmup = atoll(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && hasValue) cfg.seed = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--threads") == 0 && hasValue) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--vehicles") == 0 && hasValue) onlyVehicles = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--scenario") == 0 && hasValue) {
+            const char* name = argv[++i];
+            for (int k = 0; k < SCENARIO_COUNT; k++) if (strcmp(name, SCENARIO_NAMES[k]) == 0) onlyScenario = k;
+            if (onlyScenario < 0) { PrintUsage(); return 1; }
+        }
+        else if (strcmp(argv[i], "--config") == 0 && hasValue) configPath = argv[++i];
+        else if (strcmp(argv[i], "--accidents") == 0 && hasValue) maxAccidents = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--no-simd") == 0) cfg.simd = false;
+        else if (strcmp(argv[i], "--lod") == 0) cfg.lod = true;
+        else { PrintUsage(); return 1; }
+    }
+    std::string configError;
+    if (configPath && !LoadWorldConfig(configPath, cfg.world, configError)) { fprintf(stderr, "%s\n", configError.c_str()); return 1; }
+    if (cfg.ticks <= 0 || cfg.warmup < 0 || threads < 0 || onlyVehicles < 0 || maxAccidents < 0) { PrintUsage(); return 1; }
+    if (maxAccidents > 0) cfg.world.maxAccidents = maxAccidents;
+
+    ThreadPool pool((unsigned)threads);
+    cfg.pool = &pool;
+
+    std::vector<int> densities = { 100, 1000, 10000, 100000 };
+    if (onlyVehicles) densities = { onlyVehicles };
+    for (int vehicles : densities) {
+        for (int k = 0; k < SCENARIO_COUNT; k++) {
+            if (onlyScenario < 0 || onlyScenario == k) RunCase(cfg, (Scenario)k, vehicles);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,132 @@
+#pragma once
+// User commands and their recording. Front ends never call the simulation's
+// event functions directly; they submit a command, the simulation applies
+// it at the start of its next tick, and the (tick, command) pair can be
+// written to a log. Feeding that log back into a simulation with the same
+// seed replays the run bit for bit.
+//
+// Log file layout (little endian):
+//   "TRCL" | u32 version | u64 seed | u32 count | count x { varint tickDelta, u8 command, [args] }
+// where args, only for commands that take them, is
+//   varint road | varint index | varint count | f32 value
+// Version 1 logs predate arguments and still load.
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+enum CommandType : uint8_t {
+    CMD_CALL_AMBULANCE, CMD_CALL_DEPANNAGE, CMD_TRIGGER_ACCIDENT, CMD_CALL_SCHOOL_BUS,
+    CMD_SPAWN_CARS,            // `count` cars lined up behind the spawn point of `road`, lane `index`
+    CMD_ACCIDENT_AT,           // the accident candidates closest to world X `value` crash
+    CMD_SET_SIGNAL_CYCLE,      // light `index` of `road` switches every `value` seconds from its next change
+    CMD_COUNT
+};
+
+inline bool CommandTakesArgs(CommandType type) { return type >= CMD_SPAWN_CARS; }
+
+// Zero for the commands that take none
+struct CommandArgs {
+    uint16_t road = 0;
+    uint16_t index = 0;
+    uint32_t count = 0;
+    float value = 0.0f;
+};
+
+struct Command {
+    uint32_t tick;
+    CommandType type;
+    CommandArgs args;
+};
+
+class CommandLog {
+private:
+    static constexpr uint32_t VERSION = 2;
+    std::vector<Command> commands;
+    uint64_t seed = 0;
+    size_t cursor = 0;
+
+    static void WriteVarint(FILE* f, uint32_t v) {
+        while (v >= 0x80) { fputc((int)(v & 0x7F) | 0x80, f); v >>= 7; }
+        fputc((int)v, f);
+    }
+    static bool ReadVarint(FILE* f, uint32_t& v) {
+        v = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            int c = fgetc(f);
+            if (c == EOF) return false;
+            v |= (uint32_t)(c & 0x7F) << shift;
+            if (!(c & 0x80)) return true;
+        }
+        return false;
+    }
+
+public:
+    void SetSeed(uint64_t s) { seed = s; }
+    uint64_t GetSeed() const { return seed; }
+    size_t Size() const { return commands.size(); }
+
+    void Record(uint32_t tick, CommandType type, const CommandArgs& args) { commands.push_back({ tick, type, args }); }
+
+    // Next recorded command stamped for this tick, if any
+    bool Pop(uint32_t tick, Command& command) {
+        if (cursor >= commands.size() || commands[cursor].tick != tick) return false;
+        command = commands[cursor++];
+        return true;
+    }
+    bool Finished() const { return cursor >= commands.size(); }
+
+    bool Save(const char* path) const {
+        FILE* f = fopen(path, "wb");
+        if (!f) return false;
+        uint32_t version = VERSION, count = (uint32_t)commands.size();
+        fwrite("TRCL", 1, 4, f);
+        fwrite(&version, sizeof(version), 1, f);
+        fwrite(&seed, sizeof(seed), 1, f);
+        fwrite(&count, sizeof(count), 1, f);
+        uint32_t last = 0;
+        for (const Command& c : commands) {
+            WriteVarint(f, c.tick - last);
+            fputc(c.type, f);
+            if (CommandTakesArgs(c.type)) {
+                WriteVarint(f, c.args.road);
+                WriteVarint(f, c.args.index);
+                WriteVarint(f, c.args.count);
+                fwrite(&c.args.value, sizeof(c.args.value), 1, f);
+            }
+            last = c.tick;
+        }
+        bool ok = ferror(f) == 0;
+        fclose(f);
+        return ok;
+    }
+
+    bool Load(const char* path) {
+        FILE* f = fopen(path, "rb");
+        if (!f) return false;
+        char magic[4];
+        uint32_t version = 0, count = 0;
+        bool ok = fread(magic, 1, 4, f) == 4 && magic[0] == 'T' && magic[1] == 'R' && magic[2] == 'C' && magic[3] == 'L'
+            && fread(&version, sizeof(version), 1, f) == 1 && (version == 1 || version == VERSION)
+            && fread(&seed, sizeof(seed), 1, f) == 1
+            && fread(&count, sizeof(count), 1, f) == 1;
+        commands.clear();
+        cursor = 0;
+        uint32_t tick = 0;
+        for (uint32_t i = 0; ok && i < count; i++) {
+            uint32_t delta, road = 0, index = 0;
+            int type;
+            Command c = {};
+            ok = ReadVarint(f, delta) && (type = fgetc(f)) != EOF && type < CMD_COUNT && (version > 1 || !CommandTakesArgs((CommandType)type));
+            if (ok && CommandTakesArgs((CommandType)type)) {
+                ok = ReadVarint(f, road) && ReadVarint(f, index) && ReadVarint(f, c.args.count)
+                    && road <= UINT16_MAX && index <= UINT16_MAX && fread(&c.args.value, sizeof(c.args.value), 1, f) == 1;
+                c.args.road = (uint16_t)road;
+                c.args.index = (uint16_t)index;
+            }
+            if (ok) { tick += delta; c.tick = tick; c.type = (CommandType)type; commands.push_back(c); }
+        }
+        fclose(f);
+        return ok;
+    }
+};
@@ -0,0 +1,307 @@
+#pragma once
+// Local control socket for driving a headless run from a test harness:
+// batches of commands in, tick-stamped acknowledgements and state counters
+// out, at whatever rate the harness can produce them. Unix domain sockets
+// only; there is no Windows build of this.
+//
+// The protocol is fixed-size little-endian records, no framing beyond
+// that. A client sends a ControlRequest, followed for CTRL_BATCH by
+// `count` ControlCommands:
+//   CTRL_BATCH      commands to apply at the start of the next tick; answered
+//                   with a ControlAck once that tick has run
+//   CTRL_COUNTERS   answered with ControlCounters right away
+//   CTRL_SUBSCRIBE  ControlCounters every `count` ticks from now on (0 stops them)
+// When the run ends every client gets ControlCounters of kind CTRL_DONE,
+// carrying the final state hash, and the socket closes.
+//
+// Commands go through Simulation::Submit() like key presses, so --record
+// captures them and the recording replays without the harness. A command
+// whose arguments do not fit the world is counted as rejected and left out.
+// A client that sends garbage, or stops reading while its replies pile up
+// past MAX_BACKLOG bytes, is disconnected.
+
+#ifndef _WIN32
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "simulation.h"
+
+enum ControlKind : uint8_t {
+    CTRL_BATCH = 1, CTRL_COUNTERS, CTRL_SUBSCRIBE,     // requests
+    CTRL_ACK = 16, CTRL_DONE                           // replies; counters reuse CTRL_COUNTERS
+};
+
+struct ControlRequest {
+    uint8_t kind;
+    uint8_t reserved;
+    uint16_t count;             // commands in a batch, or ticks between counters
+    uint32_t sequence;          // echoed in the reply
+};
+
+struct ControlCommand {
+    uint8_t type;               // CommandType
+    uint8_t reserved;
+    uint16_t road;
+    uint16_t index;             // lane or light
+    uint16_t reserved2;
+    uint32_t count;
+    float value;
+};
+
+struct ControlAck {
+    uint8_t kind;               // CTRL_ACK
+    uint8_t reserved;
+    uint16_t rejected;
+    uint32_t sequence;
+    uint32_t tick;              // the tick the batch was applied on
+    uint32_t accepted;
+};
+
+struct ControlCounters {
+    uint8_t kind;               // CTRL_COUNTERS or CTRL_DONE
+    uint8_t reserved[3];
+    uint32_t sequence;          // of the request; 0 for a subscription or CTRL_DONE
+    uint32_t tick;              // ticks run so far
+    uint32_t vehicles;          // detailed and in flow
+    uint32_t incidents;         // open, from staged to towed
+    uint32_t ambulances;        // on the road
+    int64_t spawned, despawned, dropped, accidents, yields;
+    uint64_t stateHash;         // CTRL_DONE only
+};
+
+static_assert(sizeof(ControlRequest) == 8 && sizeof(ControlCommand) == 16 && sizeof(ControlAck) == 16 && sizeof(ControlCounters) == 72,
+              "control records must have the same layout on every compiler");
+
+class ControlServer {
+public:
+    static constexpr uint16_t MAX_BATCH = 4096;
+    static constexpr size_t MAX_BACKLOG = 1 << 20;
+    static constexpr size_t MAX_CLIENTS = 16;
+
+private:
+    struct Client {
+        int fd = -1;
+        std::vector<uint8_t> in, out;
+        uint32_t every = 0;             // ticks between subscribed counters
+        uint32_t nextTick = 0;
+        std::vector<ControlAck> acks;   // batches submitted for the coming tick
+    };
+
+    int listenFd = -1;
+    std::string path;
+    std::vector<Client> clients;
+
+    static bool SetNonBlocking(int fd) {
+        int flags = fcntl(fd, F_GETFL, 0);
+        return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+    }
+
+    template <class T> static void Append(std::vector<uint8_t>& out, const T& record) {
+        size_t at = out.size();
+        out.resize(at + sizeof(T));
+        memcpy(&out[at], &record, sizeof(T));
+    }
+
+    static ControlCounters Counters(const Simulation& sim, ControlKind kind, uint32_t sequence) {
+        ControlCounters c;
+        memset(&c, 0, sizeof(c));
+        const SimStats& st = sim.GetStats();
+        c.kind = kind;
+        c.sequence = sequence;
+        c.tick = sim.GetTick();
+        c.vehicles = (uint32_t)(sim.VehicleCount() + sim.FlowCount());
+        c.incidents = (uint32_t)sim.GetIncidents().Count();
+        c.ambulances = (uint32_t)sim.AmbulanceCount();
+        c.spawned = st.spawned; c.despawned = st.despawned; c.dropped = st.dropped;
+        c.accidents = st.accidents; c.yields = st.yields;
+        return c;
+    }
+
+    void Accept() {
+        for (;;) {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd < 0) return;
+            if (clients.size() >= MAX_CLIENTS || !SetNonBlocking(fd)) { close(fd); continue; }
+            clients.emplace_back();
+            clients.back().fd = fd;
+        }
+    }
+
+    // Reads what has arrived and handles every complete request; false if
+    // the client is gone or broke the protocol
+    bool Read(Client& c, Simulation& sim) {
+        uint8_t buf[65536];
+        for (;;) {
+            ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+            if (n > 0) { c.in.insert(c.in.end(), buf, buf + n); continue; }
+            if (n == 0) return false;
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+
+        size_t at = 0;
+        while (c.in.size() - at >= sizeof(ControlRequest)) {
+            ControlRequest req;
+            memcpy(&req, &c.in[at], sizeof(req));
+            if (req.kind == CTRL_BATCH) {
+                if (req.count > MAX_BATCH) return false;
+                size_t size = sizeof(req) + sizeof(ControlCommand) * req.count;
+                if (c.in.size() - at < size) break;
+                ControlAck ack = { CTRL_ACK, 0, 0, req.sequence, sim.GetTick(), 0 };
+                for (uint16_t k = 0; k < req.count; k++) {
+                    ControlCommand cmd;
+                    memcpy(&cmd, &c.in[at + sizeof(req) + sizeof(cmd) * k], sizeof(cmd));
+                    CommandArgs args;
+                    args.road = cmd.road; args.index = cmd.index; args.count = cmd.count; args.value = cmd.value;
+                    if (cmd.type < CMD_COUNT && sim.Accepts((CommandType)cmd.type, args)) {
+                        sim.Submit((CommandType)cmd.type, args);
+                        ack.accepted++;
+                    } else {
+                        ack.rejected++;
+                    }
+                }
+                c.acks.push_back(ack);
+                at += size;
+            } else if (req.kind == CTRL_COUNTERS) {
+                Append(c.out, Counters(sim, CTRL_COUNTERS, req.sequence));
+                at += sizeof(req);
+            } else if (req.kind == CTRL_SUBSCRIBE) {
+                c.every = req.count;
+                c.nextTick = sim.GetTick() + req.count;
+                at += sizeof(req);
+            } else {
+                return false;
+            }
+        }
+        c.in.erase(c.in.begin(), c.in.begin() + at);
+        return true;
+    }
+
+    // Sends as much of the backlog as the socket takes; false if the client is gone
+    static bool Flush(Client& c) {
+        size_t sent = 0;
+        while (sent < c.out.size()) {
+            ssize_t n = send(c.fd, c.out.data() + sent, c.out.size() - sent, 0);
+            if (n > 0) { sent += (size_t)n; continue; }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            return false;
+        }
+        c.out.erase(c.out.begin(), c.out.begin() + sent);
+        return c.out.size() <= MAX_BACKLOG;
+    }
+
+    void Drop(size_t k) {
+        close(clients[k].fd);
+        clients.erase(clients.begin() + k);
+    }
+
+public:
+    ControlServer() = default;
+    ControlServer(const ControlServer&) = delete;
+    ControlServer& operator=(const ControlServer&) = delete;
+    ~ControlServer() { Close(); }
+
+    // Listens at `socketPath`, replacing a stale socket file left there
+    bool Open(const char* socketPath, std::string& error) {
+        Close();
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(socketPath) >= sizeof(addr.sun_path)) { error = std::string(socketPath) + ": socket path is too long"; return false; }
+        memcpy(addr.sun_path, socketPath, strlen(socketPath));
+        listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenFd < 0) { error = std::string("cannot create a socket: ") + strerror(errno); return false; }
+        unlink(socketPath);
+        if (bind(listenFd, (const sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd, 4) != 0 || !SetNonBlocking(listenFd)) {
+            error = std::string(socketPath) + ": " + strerror(errno);
+            close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+        path = socketPath;
+        // A harness that disconnects mid-send must not kill the run
+        signal(SIGPIPE, SIG_IGN);
+        return true;
+    }
+
+    void Close() {
+        for (Client& c : clients) close(c.fd);
+        clients.clear();
+        if (listenFd < 0) return;
+        close(listenFd);
+        unlink(path.c_str());
+        listenFd = -1;
+    }
+
+    bool IsOpen() const { return listenFd >= 0; }
+    size_t ClientCount() const { return clients.size(); }
+
+    // Blocks until a client connects
+    void WaitForClient() {
+        while (clients.empty() && listenFd >= 0) {
+            pollfd p = { listenFd, POLLIN, 0 };
+            if (poll(&p, 1, -1) < 0 && errno != EINTR) return;
+            Accept();
+        }
+    }
+
+    // Before Step(): takes new clients and submits whatever commands have arrived
+    void Poll(Simulation& sim) {
+        if (listenFd < 0) return;
+        Accept();
+        for (size_t k = clients.size(); k-- > 0;) {
+            if (!Read(clients[k], sim)) Drop(k);
+        }
+    }
+
+    // After Step(): acknowledges the batches that tick applied and sends
+    // subscribed counters
+    void Publish(const Simulation& sim) {
+        uint32_t applied = sim.GetTick() - 1;
+        for (size_t k = clients.size(); k-- > 0;) {
+            Client& c = clients[k];
+            for (ControlAck& ack : c.acks) {
+                ack.tick = applied;
+                Append(c.out, ack);
+            }
+            c.acks.clear();
+            if (c.every && sim.GetTick() >= c.nextTick) {
+                Append(c.out, Counters(sim, CTRL_COUNTERS, 0));
+                c.nextTick = sim.GetTick() + c.every;
+            }
+            if (!c.out.empty() && !Flush(c)) Drop(k);
+        }
+    }
+
+    // End of the run: CTRL_DONE to everyone, waiting up to a second for
+    // slow readers to take it, then closes
+    void Finish(const Simulation& sim) {
+        ControlCounters done = Counters(sim, CTRL_DONE, 0);
+        done.stateHash = sim.StateHash();
+        for (Client& c : clients) Append(c.out, done);
+        for (int wait = 0; wait < 100; wait++) {
+            bool pending = false;
+            for (size_t k = clients.size(); k-- > 0;) {
+                if (clients[k].out.empty()) continue;
+                if (!Flush(clients[k])) { Drop(k); continue; }
+                pending = pending || !clients[k].out.empty();
+            }
+            if (!pending) break;
+            usleep(10000);
+        }
+        Close();
+    }
+};
+
+#endif
@@ -0,0 +1,95 @@
+#pragma once
+// Cheap stand-in for the cars of one carriageway that nobody is looking at.
+// Each lane is a queue of compact records, front car first, that only
+// advance and keep their distance: no lane index, no stop decisions, no
+// lights. The simulation moves cars between here and the VehicleStore as
+// they leave and enter the detailed parts of the road.
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "vehicle_store.h"
+
+// One queued car, with everything needed to turn it back into a vehicle.
+// Laid out without padding so lanes can be hashed and saved as raw bytes.
+struct FlowCar {
+    float x;
+    float speed;
+    uint16_t flags;
+    uint8_t sprite;
+    uint8_t spare;
+    Tint color;
+};
+
+class FlowLanes {
+private:
+    std::vector<std::vector<FlowCar>> lanes;   // each ordered front first
+    size_t count = 0;
+    bool dirRight;
+
+    // Distance travelled along the road; larger is further ahead
+    float Progress(float x) const { return dirRight ? x : -x; }
+
+public:
+    FlowLanes(int laneCount, bool right) : lanes(laneCount), dirRight(right) {}
+
+    // Any lane may end up holding the whole road
+    void Reserve(uint32_t n) {
+        for (std::vector<FlowCar>& lane : lanes) lane.reserve(n);
+    }
+
+    int LaneCount() const { return (int)lanes.size(); }
+    size_t Count() const { return count; }
+    bool Empty() const { return count == 0; }
+    std::vector<FlowCar>& Lane(int lane) { return lanes[lane]; }
+    const std::vector<FlowCar>& Lane(int lane) const { return lanes[lane]; }
+
+    // Number of cars in a lane strictly ahead of x; the nearest of them is
+    // the one just before that index
+    size_t AheadOf(int lane, float x) const {
+        const std::vector<FlowCar>& cars = lanes[lane];
+        float p = Progress(x);
+        size_t lo = 0, hi = cars.size();
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (Progress(cars[mid].x) > p) lo = mid + 1; else hi = mid;
+        }
+        return lo;
+    }
+
+    // Keeps the lane in order; a car level with others goes behind them
+    void Insert(int lane, const FlowCar& car) {
+        std::vector<FlowCar>& cars = lanes[lane];
+        size_t pos = cars.size();
+        float p = Progress(car.x);
+        while (pos > 0 && Progress(cars[pos - 1].x) < p) pos--;
+        cars.insert(cars.begin() + pos, car);
+        count++;
+    }
+
+    // Bulk loading: append in any order, then Sort() once
+    void Append(int lane, const FlowCar& car) {
+        lanes[lane].push_back(car);
+        count++;
+    }
+    void Sort() {
+        for (std::vector<FlowCar>& cars : lanes) {
+            std::stable_sort(cars.begin(), cars.end(), [this](const FlowCar& a, const FlowCar& b) { return Progress(a.x) > Progress(b.x); });
+        }
+    }
+
+    // The caller compacted a lane in place down to n cars
+    void Truncate(int lane, size_t n) {
+        count -= lanes[lane].size() - n;
+        lanes[lane].resize(n);
+    }
+
+    template <class A> void Transfer(A& ar, uint32_t limit) {
+        uint32_t laneCount = (uint32_t)lanes.size();
+        ar.Value(laneCount);
+        ar.Check(laneCount == lanes.size(), "snapshot flow lanes do not match the road");
+        if (laneCount != lanes.size()) return;
+        count = 0;
+        for (std::vector<FlowCar>& cars : lanes) { ar.Array(cars, limit); count += cars.size(); }
+    }
+};
@@ -0,0 +1,204 @@
+// Headless batch runner: steps the traffic model as fast as the CPU allows,
+// without a window, input or audio. Used for capacity studies.
+//
+//   headless [--ticks N] [--seed N] [--operator] [--report-every N]
+//            [--record FILE] [--replay FILE] [--threads N] [--profile FILE]
+//            [--config FILE] [--trajectory FILE]
+//            [--load-snapshot FILE] [--save-snapshot FILE] [--no-simd]
+//            [--lod LEFT:RIGHT] [--control SOCKET]
+//
+// --threads runs the per-lane phases on a pool of N threads (0 = one per
+// core). The outcome, hash included, is the same for every N.
+// --profile writes per-phase timings as CSV; it needs a TRAFFIC_PROFILE
+// (DEBUG) build.
+// --config loads the road network and tuning from a JSON file such as the
+// repository's config.json; without it the built-in layout is used.
+// --trajectory streams every tick's vehicles, light changes and incident
+// changes to a binary file (src/trajectory.h) that the window can play back
+// with --play.
+// --load-snapshot starts from a checkpoint instead of an empty road and
+// --save-snapshot writes one after the last tick; --ticks counts the ticks
+// run in between. Warm up once, save, then fork any number of runs from the
+// file. The generator comes back as it was saved, so forks only diverge
+// through their commands, unless --seed is also given to reseed them.
+//
+// --lod simulates cars in detail only around the world X range LEFT..RIGHT
+// (standing in for the window's camera), the lights, crashes and special
+// vehicles, and runs the rest as per-lane flows. The hash differs from a
+// run without it but is reproducible for the same range. It cannot be
+// combined with --trajectory, which only sees cars simulated in detail.
+// --no-simd moves cars with the scalar kernel even where AVX2 is available;
+// the hash must not change.
+// --control listens on a Unix domain socket (src/control_socket.h) and waits
+// for a client before the first tick; from then on the client's command
+// batches go in between ticks and it gets acknowledgements and counters
+// back. Not available on Windows.
+//
+// The run ends with a hash of the full model state. Replaying a recording
+// must print the same hash as the run that produced it.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include "simulation.h"
+#include "operator.h"
+#include "trajectory.h"
+#include "control_socket.h"
+
+static void PrintUsage() {
+    printf("usage: headless [--ticks N] [--seed N] [--operator] [--report-every N] [--record FILE] [--replay FILE] [--threads N] [--profile FILE] [--config FILE] [--trajectory FILE] [--load-snapshot FILE] [--save-snapshot FILE] [--no-simd] [--lod LEFT:RIGHT] [--control SOCKET]\n");
+}
+
+int main(int argc, char** argv) {
+    long long ticks = 60LL * 60 * 60;
+    uint64_t seed = 1;
+    const char* recordPath = nullptr;
+    const char* replayPath = nullptr;
+    const char* profilePath = nullptr;
+    const char* configPath = nullptr;
+    const char* trajectoryPath = nullptr;
+    const char* loadSnapshotPath = nullptr;
+    const char* saveSnapshotPath = nullptr;
+    const char* controlPath = nullptr;
+    bool seedGiven = false;
+    bool useOperator = false;
+    long long reportEvery = 0;
+    int threads = 1;
+    bool simd = true;
+    bool lod = false;
+    float focusLeft = 0.0f, focusRight = 0.0f;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--ticks") == 0 && hasValue) ticks = atoll(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && hasValue) { seed = strtoull(argv[++i], nullptr, 10); seedGiven = true; }
+        else if (strcmp(argv[i], "--record") == 0 && hasValue) recordPath = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && hasValue) replayPath = argv[++i];
+        else if (strcmp(argv[i], "--operator") == 0) useOperator = true;
+        else if (strcmp(argv[i], "--report-every") == 0 && hasValue) reportEvery = atoll(argv[++i]);
+        else if (strcmp(argv[i], "--threads") == 0 && hasValue) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--profile") == 0 && hasValue) profilePath = argv[++i];
+        else if (strcmp(argv[i], "--config") == 0 && hasValue) configPath = argv[++i];
+        else if (strcmp(argv[i], "--trajectory") == 0 && hasValue) trajectoryPath = argv[++i];
+        else if (strcmp(argv[i], "--load-snapshot") == 0 && hasValue) loadSnapshotPath = argv[++i];
+        else if (strcmp(argv[i], "--save-snapshot") == 0 && hasValue) saveSnapshotPath = argv[++i];
+        else if (strcmp(argv[i], "--no-simd") == 0) simd = false;
+        else if (strcmp(argv[i], "--control") == 0 && hasValue) controlPath = argv[++i];
+        else if (strcmp(argv[i], "--lod") == 0 && hasValue) {
+            lod = sscanf(argv[++i], "%f:%f", &focusLeft, &focusRight) == 2 && focusLeft <= focusRight;
+            if (!lod) { PrintUsage(); return 1; }
+        }
+        else { PrintUsage(); return 1; }
+    }
+    if (ticks <= 0 || threads < 0) { PrintUsage(); return 1; }
+    // Cars in flow have no slot in the store, so a trajectory would miss them
+    if (lod && trajectoryPath) { fprintf(stderr, "--lod cannot be combined with --trajectory\n"); return 1; }
+    if (loadSnapshotPath && (recordPath || replayPath)) { fprintf(stderr, "--record and --replay start from an empty road and cannot be combined with --load-snapshot\n"); return 1; }
+#ifdef _WIN32
+    if (controlPath) { fprintf(stderr, "--control needs Unix domain sockets and is not available on Windows\n"); return 1; }
+#endif
+#ifndef TRAFFIC_PROFILE
+    if (profilePath) { fprintf(stderr, "--profile needs a build with TRAFFIC_PROFILE (make BUILD_MODE=DEBUG)\n"); return 1; }
+#endif
+
+    WorldConfig world;
+    std::string configError;
+    if (configPath && !LoadWorldConfig(configPath, world, configError)) { fprintf(stderr, "%s\n", configError.c_str()); return 1; }
+
+    CommandLog log;
+    if (replayPath) {
+        if (!log.Load(replayPath)) { fprintf(stderr, "cannot read replay %s\n", replayPath); return 1; }
+        seed = log.GetSeed();
+        useOperator = false;
+    }
+    log.SetSeed(seed);
+
+    ThreadPool pool((unsigned)threads);
+    Simulation sim(world);
+    sim.Init(seed);
+    sim.SetThreadPool(&pool);
+    sim.SetSimd(simd);
+    sim.SetLevelOfDetail(lod);
+    sim.SetFocus(focusLeft, focusRight);
+    double loadMs = 0.0;
+    if (loadSnapshotPath) {
+        std::string snapshotError;
+        auto loadStart = std::chrono::steady_clock::now();
+        if (!sim.LoadSnapshotFile(loadSnapshotPath, snapshotError)) { fprintf(stderr, "%s\n", snapshotError.c_str()); return 1; }
+        loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+        if (seedGiven) sim.Init(seed);
+    }
+    if (recordPath) sim.SetRecorder(&log);
+    Operator op;
+    TrajectoryRecorder trajectory;
+    if (trajectoryPath && !trajectory.Open(trajectoryPath, sim, seed)) { fprintf(stderr, "cannot write trajectory %s\n", trajectoryPath); return 1; }
+#ifndef _WIN32
+    ControlServer control;
+    if (controlPath) {
+        std::string controlError;
+        if (!control.Open(controlPath, controlError)) { fprintf(stderr, "%s\n", controlError.c_str()); return 1; }
+        fprintf(stderr, "waiting for a client on %s\n", controlPath);
+        control.WaitForClient();
+    }
+#endif
+
+    auto start = std::chrono::steady_clock::now();
+    for (long long t = 0; t < ticks; t++) {
+        if (useOperator) op.Update(sim);
+        Command cmd;
+        while (replayPath && log.Pop(sim.GetTick(), cmd)) sim.Submit(cmd);
+#ifndef _WIN32
+        if (controlPath) control.Poll(sim);
+#endif
+        sim.Step();
+#ifndef _WIN32
+        if (controlPath) control.Publish(sim);
+#endif
+        if (trajectoryPath) trajectory.Capture(sim);
+        if (reportEvery > 0 && (t + 1) % reportEvery == 0) {
+            printf("tick %lld: %zu vehicles, %lld accidents\n", t + 1, sim.VehicleCount() + sim.FlowCount(), sim.GetStats().accidents);
+        }
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+#ifndef _WIN32
+    if (controlPath) control.Finish(sim);
+#endif
+    if (!trajectory.Close()) { fprintf(stderr, "cannot write trajectory %s\n", trajectoryPath); return 1; }
+    double saveMs = 0.0;
+    if (saveSnapshotPath) {
+        auto saveStart = std::chrono::steady_clock::now();
+        if (!sim.SaveSnapshotFile(saveSnapshotPath)) { fprintf(stderr, "cannot write snapshot %s\n", saveSnapshotPath); return 1; }
+        saveMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - saveStart).count();
+    }
+
+    const SimStats& stats = sim.GetStats();
+    printf("ticks        %lld\n", stats.ticks);
+    printf("sim_seconds  %.1f\n", stats.simTime);
+    printf("wall_seconds %.3f\n", wall);
+    printf("ticks_per_s  %.0f\n", wall > 0.0 ? stats.ticks / wall : 0.0);
+    printf("speedup      %.1fx\n", wall > 0.0 ? stats.simTime / wall : 0.0);
+    printf("spawned      %lld\n", stats.spawned);
+    printf("despawned    %lld\n", stats.despawned);
+    printf("accidents    %lld\n", stats.accidents);
+    printf("yields       %lld\n", stats.yields);
+    printf("dropped      %lld\n", stats.dropped);
+    printf("vehicles     %zu\n", sim.VehicleCount() + sim.FlowCount());
+    if (lod) printf("lod          %zu detailed, %zu in flow, %lld promoted, %lld demoted\n", sim.VehicleCount(), sim.FlowCount(), stats.promoted, stats.demoted);
+    PoolStats pools = sim.GetPoolStats();
+    printf("pool         %zu capacity, %zu high-water\n", pools.capacity, pools.highWater);
+    printf("roads        %d\n", sim.RoadCount());
+    printf("threads      %zu\n", pool.Size());
+    printf("kinematics   %s\n", sim.GetKinematicsPath());
+    printf("seed         %llu\n", (unsigned long long)seed);
+    printf("state_hash   %016llx\n", (unsigned long long)sim.StateHash());
+    if (loadSnapshotPath) printf("snapshot_in  %s, %.2f ms\n", loadSnapshotPath, loadMs);
+    if (saveSnapshotPath) printf("snapshot_out %s, %.2f ms\n", saveSnapshotPath, saveMs);
+    if (trajectoryPath) printf("trajectory   %llu frames, %llu bytes\n", trajectory.FrameCount(), trajectory.BytesWritten());
+
+    if (recordPath && !log.Save(recordPath)) { fprintf(stderr, "cannot write recording %s\n", recordPath); return 1; }
+#ifdef TRAFFIC_PROFILE
+    if (profilePath && !Profiler::Get().WriteCsv(profilePath)) { fprintf(stderr, "cannot write profile %s\n", profilePath); return 1; }
+#endif
+    return 0;
+}
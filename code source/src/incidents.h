@@ -0,0 +1,157 @@
+#pragma once
+// Accidents under way and the queues of accidents waiting for a responder.
+// An incident lives in a slot of the IncidentTable from the moment two
+// cars are set on a collision course until its wrecks have been towed off
+// the map. Everything outside the table refers to an incident by
+// IncidentHandle, which stops resolving once the incident is closed, the
+// same way VehicleHandle does for vehicles.
+
+#include <cstdint>
+#include <vector>
+#include "vehicle_store.h"
+
+enum IncidentState : uint8_t {
+    INCIDENT_PENDING,      // the reckless car is closing in on its target
+    INCIDENT_ACTIVE,       // both cars have crashed and block their lane
+    INCIDENT_CLEARING      // the wrecks are hooked to a tow truck
+};
+
+struct IncidentHandle {
+    uint32_t slot = 0;
+    uint32_t generation = 0;
+    bool IsNull() const { return generation == 0; }
+    bool operator==(const IncidentHandle& o) const { return slot == o.slot && generation == o.generation; }
+    bool operator!=(const IncidentHandle& o) const { return !(*this == o); }
+};
+
+struct Incident {
+    IncidentState state = INCIDENT_PENDING;
+    float x = 0.0f, y = 0.0f;              // crash site, set once the cars touch
+    VehicleHandle car1, car2;              // car2 runs into car1
+    VehicleHandle ambulance, tow;          // responders assigned by dispatch
+    bool ambulanceLeft = false;            // its ambulance has set off for the hospital
+    uint32_t crashTick = 0;                // tick the cars touched
+};
+
+class IncidentTable {
+private:
+    std::vector<Incident> slots;
+    std::vector<uint32_t> slotGeneration;
+    std::vector<uint8_t> live;
+    std::vector<uint32_t> freeSlots;
+    size_t count = 0;
+
+public:
+    // Room for n incidents at once, so opening one never allocates
+    void Reserve(size_t n) {
+        slots.reserve(n); slotGeneration.reserve(n); live.reserve(n); freeSlots.reserve(n);
+    }
+
+    IncidentHandle Open(const Incident& incident) {
+        uint32_t slot;
+        if (!freeSlots.empty()) { slot = freeSlots.back(); freeSlots.pop_back(); }
+        else { slot = (uint32_t)slots.size(); slots.emplace_back(); slotGeneration.push_back(1); live.push_back(0); }
+        slots[slot] = incident;
+        live[slot] = 1;
+        count++;
+        return IncidentHandle{ slot, slotGeneration[slot] };
+    }
+
+    void Close(IncidentHandle h) {
+        if (!Get(h)) return;
+        live[h.slot] = 0;
+        slotGeneration[h.slot]++;
+        freeSlots.push_back(h.slot);
+        count--;
+    }
+
+    Incident* Get(IncidentHandle h) {
+        return h.slot < slots.size() && live[h.slot] && slotGeneration[h.slot] == h.generation ? &slots[h.slot] : nullptr;
+    }
+    const Incident* Get(IncidentHandle h) const {
+        return h.slot < slots.size() && live[h.slot] && slotGeneration[h.slot] == h.generation ? &slots[h.slot] : nullptr;
+    }
+
+    size_t Count() const { return count; }
+    size_t CountIn(IncidentState state) const {
+        size_t n = 0;
+        for (uint32_t k = 0; k < SlotCount(); k++) if (live[k] && slots[k].state == state) n++;
+        return n;
+    }
+
+    // Slots are visited in index order; skip the ones that are not live
+    uint32_t SlotCount() const { return (uint32_t)slots.size(); }
+    bool IsLive(uint32_t slot) const { return live[slot] != 0; }
+    Incident& At(uint32_t slot) { return slots[slot]; }
+    const Incident& At(uint32_t slot) const { return slots[slot]; }
+    IncidentHandle HandleAt(uint32_t slot) const { return IncidentHandle{ slot, slotGeneration[slot] }; }
+
+    template <class A> void Transfer(A& ar) {
+        ar.Records(slots, UINT32_MAX, [&](Incident& inc) {
+            ar.Value(inc.state); ar.Value(inc.x); ar.Value(inc.y);
+            ar.Value(inc.car1); ar.Value(inc.car2); ar.Value(inc.ambulance); ar.Value(inc.tow);
+            ar.Value(inc.ambulanceLeft); ar.Value(inc.crashTick);
+        });
+        ar.Array(slotGeneration); ar.Array(live); ar.Array(freeSlots);
+        uint64_t n = count;
+        ar.Value(n);
+        count = (size_t)n;
+        if (!A::LOADING) return;
+        size_t open = 0;
+        for (uint8_t l : live) open += l != 0;
+        ar.Check(slotGeneration.size() == slots.size() && live.size() == slots.size() && open == count, "snapshot incident table does not agree");
+    }
+};
+
+// Incidents waiting for one kind of responder, oldest first. Entries whose
+// incident has closed in the meantime are dropped when they reach the front.
+// Kept in a vector read from `head`; the consumed front is reclaimed by
+// sliding the rest down, so the storage is reused instead of reallocated.
+class DispatchQueue {
+private:
+    std::vector<IncidentHandle> waiting;
+    size_t head = 0;
+
+    bool Empty() const { return head == waiting.size(); }
+
+    void DropClosed(const IncidentTable& table) {
+        while (!Empty() && !table.Get(waiting[head])) head++;
+    }
+
+public:
+    void Reserve(size_t n) { waiting.reserve(n); }
+
+    void Push(IncidentHandle h) {
+        if (head > 0 && (Empty() || head * 2 >= waiting.size())) {
+            waiting.erase(waiting.begin(), waiting.begin() + head);
+            head = 0;
+        }
+        waiting.push_back(h);
+    }
+
+    bool Front(const IncidentTable& table, IncidentHandle& out) {
+        DropClosed(table);
+        if (Empty()) return false;
+        out = waiting[head];
+        return true;
+    }
+
+    bool Pop(const IncidentTable& table, IncidentHandle& out) {
+        if (!Front(table, out)) return false;
+        head++;
+        return true;
+    }
+
+    template <class A> void Transfer(A& ar) {
+        ar.Array(waiting);
+        uint64_t h = head;
+        ar.Value(h);
+        ar.Check(h <= waiting.size(), "snapshot dispatch queue does not agree");
+        head = h <= waiting.size() ? (size_t)h : waiting.size();
+    }
+
+    // Open incidents in the queue, in order; f returns false to stop early
+    template <class F> void ForEachOpen(const IncidentTable& table, F f) const {
+        for (size_t k = head; k < waiting.size(); k++) if (table.Get(waiting[k]) && !f(waiting[k])) return;
+    }
+};
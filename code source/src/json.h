@@ -0,0 +1,199 @@
+#pragma once
+// Minimal JSON reader for the configuration files. Parses the whole text
+// into a JsonValue tree; numbers are doubles, objects keep their keys in
+// file order. Errors come back as a message with the line and column,
+// never as exceptions.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct JsonValue {
+    enum Type { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT };
+    Type type = NUL;
+    bool boolean = false;
+    double number = 0.0;
+    std::string text;
+    std::vector<JsonValue> items;                               // ARRAY
+    std::vector<std::pair<std::string, JsonValue>> members;     // OBJECT
+
+    bool IsObject() const { return type == OBJECT; }
+    bool IsArray() const { return type == ARRAY; }
+    bool IsNumber() const { return type == NUMBER; }
+    bool IsString() const { return type == STRING; }
+    bool IsBool() const { return type == BOOL; }
+
+    // Member of an object by key, nullptr if absent or not an object
+    const JsonValue* Find(const char* key) const {
+        if (type != OBJECT) return nullptr;
+        for (const auto& m : members) if (m.first == key) return &m.second;
+        return nullptr;
+    }
+};
+
+class JsonParser {
+private:
+    const std::string& src;
+    size_t pos = 0;
+    std::string& error;
+    int depth = 0;
+
+    static constexpr int MAX_DEPTH = 64;
+
+    bool Fail(const char* what) {
+        int line = 1, col = 1;
+        for (size_t k = 0; k < pos && k < src.size(); k++) {
+            if (src[k] == '\n') { line++; col = 1; } else col++;
+        }
+        char buf[160];
+        snprintf(buf, sizeof(buf), "line %d, column %d: %s", line, col, what);
+        error = buf;
+        return false;
+    }
+
+    void SkipSpace() {
+        while (pos < src.size() && (src[pos] == ' ' || src[pos] == '\t' || src[pos] == '\n' || src[pos] == '\r')) pos++;
+    }
+
+    bool Literal(const char* word, JsonValue& out, JsonValue::Type type, bool value) {
+        size_t n = strlen(word);
+        if (src.compare(pos, n, word) != 0) return Fail("unexpected character");
+        pos += n;
+        out.type = type;
+        out.boolean = value;
+        return true;
+    }
+
+    bool ParseString(std::string& out) {
+        pos++;  // opening quote
+        out.clear();
+        while (pos < src.size()) {
+            char c = src[pos++];
+            if (c == '"') return true;
+            if ((unsigned char)c < 0x20) return Fail("control character in string");
+            if (c != '\\') { out += c; continue; }
+            if (pos >= src.size()) break;
+            char e = src[pos++];
+            switch (e) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    if (pos + 4 > src.size()) return Fail("truncated \\u escape");
+                    unsigned code = (unsigned)strtoul(src.substr(pos, 4).c_str(), nullptr, 16);
+                    pos += 4;
+                    // Config files are ASCII in practice; encode the BMP as UTF-8
+                    if (code < 0x80) out += (char)code;
+                    else if (code < 0x800) { out += (char)(0xC0 | (code >> 6)); out += (char)(0x80 | (code & 0x3F)); }
+                    else { out += (char)(0xE0 | (code >> 12)); out += (char)(0x80 | ((code >> 6) & 0x3F)); out += (char)(0x80 | (code & 0x3F)); }
+                    break;
+                }
+                default: return Fail("unknown escape in string");
+            }
+        }
+        return Fail("unterminated string");
+    }
+
+    bool ParseNumber(JsonValue& out) {
+        const char* start = src.c_str() + pos;
+        if (*start != '-' && (*start < '0' || *start > '9')) return Fail("expected a value");
+        char* end = nullptr;
+        double v = strtod(start, &end);
+        if (end == start) return Fail("expected a value");
+        pos += (size_t)(end - start);
+        out.type = JsonValue::NUMBER;
+        out.number = v;
+        return true;
+    }
+
+    bool ParseValue(JsonValue& out) {
+        SkipSpace();
+        if (pos >= src.size()) return Fail("unexpected end of input");
+        if (++depth > MAX_DEPTH) return Fail("nesting too deep");
+        bool ok;
+        char c = src[pos];
+        if (c == '{') ok = ParseObject(out);
+        else if (c == '[') ok = ParseArray(out);
+        else if (c == '"') { out.type = JsonValue::STRING; ok = ParseString(out.text); }
+        else if (c == 't') ok = Literal("true", out, JsonValue::BOOL, true);
+        else if (c == 'f') ok = Literal("false", out, JsonValue::BOOL, false);
+        else if (c == 'n') ok = Literal("null", out, JsonValue::NUL, false);
+        else ok = ParseNumber(out);
+        depth--;
+        return ok;
+    }
+
+    bool ParseArray(JsonValue& out) {
+        out.type = JsonValue::ARRAY;
+        pos++;
+        SkipSpace();
+        if (pos < src.size() && src[pos] == ']') { pos++; return true; }
+        for (;;) {
+            out.items.emplace_back();
+            if (!ParseValue(out.items.back())) return false;
+            SkipSpace();
+            if (pos < src.size() && src[pos] == ',') { pos++; continue; }
+            if (pos < src.size() && src[pos] == ']') { pos++; return true; }
+            return Fail("expected ',' or ']' in array");
+        }
+    }
+
+    bool ParseObject(JsonValue& out) {
+        out.type = JsonValue::OBJECT;
+        pos++;
+        SkipSpace();
+        if (pos < src.size() && src[pos] == '}') { pos++; return true; }
+        for (;;) {
+            SkipSpace();
+            if (pos >= src.size() || src[pos] != '"') return Fail("expected a key string");
+            std::string key;
+            if (!ParseString(key)) return false;
+            if (out.Find(key.c_str())) return Fail("duplicate key");
+            SkipSpace();
+            if (pos >= src.size() || src[pos] != ':') return Fail("expected ':' after key");
+            pos++;
+            out.members.emplace_back(key, JsonValue());
+            if (!ParseValue(out.members.back().second)) return false;
+            SkipSpace();
+            if (pos < src.size() && src[pos] == ',') { pos++; continue; }
+            if (pos < src.size() && src[pos] == '}') { pos++; return true; }
+            return Fail("expected ',' or '}' in object");
+        }
+    }
+
+public:
+    JsonParser(const std::string& text, std::string& err) : src(text), error(err) {}
+
+    bool Parse(JsonValue& out) {
+        if (!ParseValue(out)) return false;
+        SkipSpace();
+        if (pos != src.size()) return Fail("trailing characters after the document");
+        return true;
+    }
+};
+
+inline bool ParseJson(const std::string& text, JsonValue& out, std::string& error) {
+    JsonParser parser(text, error);
+    return parser.Parse(out);
+}
+
+// Reads a whole file into a string; false if it cannot be opened or read
+inline bool ReadTextFile(const char* path, std::string& out) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    out.clear();
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out.append(buf, n);
+    bool ok = ferror(f) == 0;
+    fclose(f);
+    return ok;
+}
@@ -0,0 +1,140 @@
+#pragma once
+// Per-tick motion of plain cars: apply the stop decision, advance along the
+// road unless stopped, drift toward the target lane. StepCars runs it over a
+// dense range of one road, eight vehicles at a time with AVX2 when the CPU
+// has it and one at a time otherwise.
+//
+// Both paths do the same IEEE operations in the same order (one add for x,
+// one subtract, multiply and add for y, no fused multiply-add), so they give
+// bit-identical positions and the run hash does not depend on which one ran.
+// Stop decisions and flag tests become per-lane masks in the vector path
+// instead of branches.
+
+#include <cmath>
+#include <cstdint>
+#include "vehicle_store.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TRAFFIC_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+// Outcome of the stop decision for one vehicle, applied when it moves
+enum StopDecision : uint8_t { STOP_KEEP, STOP_NO, STOP_YES };
+
+// Lane-blend step shared by every vehicle kind
+inline void BlendLane(VehicleStore& s, uint32_t i) {
+    float dy = s.targetY[i] - s.y[i];
+    if (fabs(dy) > 0.5f) s.y[i] += dy * 0.08f; else s.y[i] = s.targetY[i];
+}
+
+// Plain driving: advance unless stopped, then drift toward the target lane
+inline void StepFreeFlow(VehicleStore& s, uint32_t i) {
+    uint16_t f = s.flags[i];
+    if (f & (VF_CRASHED | VF_TOWED)) return;
+    if (f & VF_RECKLESS) { f = (uint16_t)(f & ~VF_FORCED_STOP); s.flags[i] = f; }
+    if ((f & VF_MOVING) && !(f & VF_FORCED_STOP)) s.x[i] += (f & VF_DIR_RIGHT) ? s.speed[i] : -s.speed[i];
+    BlendLane(s, i);
+}
+
+// Scalar path, also used for the tail the vector path leaves over
+inline void StepCarsScalar(VehicleStore& s, const uint8_t* decision, uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; i++) {
+        if (decision[i] != STOP_KEEP) s.Set(i, VF_FORCED_STOP, decision[i] == STOP_YES);
+        if (s.type[i] == VEHICLE_CAR) StepFreeFlow(s, i);
+    }
+}
+
+#ifdef TRAFFIC_HAVE_AVX2
+inline bool CpuHasAvx2() {
+    static const bool has = __builtin_cpu_supports("avx2");
+    return has;
+}
+
+// Eight vehicles per iteration; returns the first index it did not handle
+__attribute__((target("avx2")))
+inline uint32_t StepCarsAvx2(VehicleStore& s, const uint8_t* decision, uint32_t begin, uint32_t end) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i forced = _mm256_set1_epi32(VF_FORCED_STOP);
+    const __m256i moving = _mm256_set1_epi32(VF_MOVING);
+    const __m256i right = _mm256_set1_epi32(VF_DIR_RIGHT);
+    const __m256i reckless = _mm256_set1_epi32(VF_RECKLESS);
+    const __m256i frozen = _mm256_set1_epi32(VF_CRASHED | VF_TOWED);
+    const __m256i keep = _mm256_set1_epi32(STOP_KEEP);
+    const __m256i yes = _mm256_set1_epi32(STOP_YES);
+    const __m256i car = _mm256_set1_epi32(VEHICLE_CAR);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 snap = _mm256_set1_ps(0.5f);
+    const __m256 rate = _mm256_set1_ps(0.08f);
+
+    uint16_t* flags = s.flags.data();
+    const uint8_t* type = s.type.data();
+    float* x = s.x.data();
+    float* y = s.y.data();
+    const float* targetY = s.targetY.data();
+    const float* speed = s.speed.data();
+
+    uint32_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256i f = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(flags + i)));
+        __m256i d = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(decision + i)));
+        __m256i t = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(type + i)));
+
+        // Stop decision: STOP_KEEP leaves the bit, otherwise it is set to STOP_YES
+        __m256i decided = _mm256_andnot_si256(_mm256_cmpeq_epi32(d, keep), _mm256_set1_epi32(-1));
+        __m256i stopBit = _mm256_and_si256(_mm256_cmpeq_epi32(d, yes), forced);
+        __m256i applied = _mm256_or_si256(_mm256_andnot_si256(forced, f), stopBit);
+        f = _mm256_blendv_epi8(f, applied, decided);
+
+        // Cars that are neither wrecked nor on a tow truck; reckless ones ignore the stop
+        __m256i active = _mm256_and_si256(_mm256_cmpeq_epi32(t, car),
+                                          _mm256_cmpeq_epi32(_mm256_and_si256(f, frozen), zero));
+        __m256i clear = _mm256_and_si256(active, _mm256_cmpgt_epi32(_mm256_and_si256(f, reckless), zero));
+        f = _mm256_andnot_si256(_mm256_and_si256(clear, forced), f);
+
+        __m256i go = _mm256_and_si256(active, _mm256_and_si256(
+            _mm256_cmpgt_epi32(_mm256_and_si256(f, moving), zero),
+            _mm256_cmpeq_epi32(_mm256_and_si256(f, forced), zero)));
+        __m256i toRight = _mm256_cmpgt_epi32(_mm256_and_si256(f, right), zero);
+
+        __m256 v = _mm256_loadu_ps(speed + i);
+        __m256 step = _mm256_blendv_ps(_mm256_xor_ps(v, sign), v, _mm256_castsi256_ps(toRight));
+        __m256 px = _mm256_loadu_ps(x + i);
+        px = _mm256_blendv_ps(px, _mm256_add_ps(px, step), _mm256_castsi256_ps(go));
+        _mm256_storeu_ps(x + i, px);
+
+        __m256 py = _mm256_loadu_ps(y + i);
+        __m256 ty = _mm256_loadu_ps(targetY + i);
+        __m256 dy = _mm256_sub_ps(ty, py);
+        __m256 far = _mm256_cmp_ps(_mm256_andnot_ps(sign, dy), snap, _CMP_GT_OQ);
+        __m256 blended = _mm256_blendv_ps(ty, _mm256_add_ps(py, _mm256_mul_ps(dy, rate)), far);
+        py = _mm256_blendv_ps(py, blended, _mm256_castsi256_ps(active));
+        _mm256_storeu_ps(y + i, py);
+
+        __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(f), _mm256_extracti128_si256(f, 1));
+        _mm_storeu_si128((__m128i*)(flags + i), packed);
+    }
+    return i;
+}
+#endif
+
+// Stop decisions and free-flow motion for dense indices [begin, end) of one
+// road. vector = false forces the scalar path.
+inline void StepCars(VehicleStore& s, const uint8_t* decision, uint32_t begin, uint32_t end, bool vector) {
+#ifdef TRAFFIC_HAVE_AVX2
+    if (vector && CpuHasAvx2()) begin = StepCarsAvx2(s, decision, begin, end);
+#else
+    (void)vector;
+#endif
+    StepCarsScalar(s, decision, begin, end);
+}
+
+// Name of the path StepCars takes, for reports
+inline const char* KinematicsPath(bool vector) {
+#ifdef TRAFFIC_HAVE_AVX2
+    if (vector && CpuHasAvx2()) return "avx2";
+#else
+    (void)vector;
+#endif
+    return "scalar";
+}
@@ -0,0 +1,198 @@
+#pragma once
+// Lane-bucketed, X-sorted view of one carriageway. Each bucket holds the
+// dense indices of the vehicles whose targetY falls in that lane, ordered
+// by X, so the car ahead and the car behind are simply the neighbouring
+// entries. The store's laneIndex/laneSlot columns record where each
+// vehicle sits, which makes neighbour lookups O(1).
+//
+// A bucket keeps free room at both ends of its buffer. Cars spawn at one
+// end of a lane and leave at the other, so adding or removing one only
+// moves the entries on the shorter side of it, and at the ends none at
+// all. When an end runs out of room the entries move back to the middle,
+// about once per half a buffer of spawns.
+
+#include <algorithm>
+#include <vector>
+#include <cmath>
+#include "vehicle_store.h"
+
+// One lane's entries in X order. Slots are positions in the lane's buffer
+// and run from Begin() to End(), not from 0.
+class LaneView {
+private:
+    const uint32_t* slots;
+    uint32_t first, last;
+
+public:
+    LaneView(const uint32_t* s, uint32_t f, uint32_t l) : slots(s), first(f), last(l) {}
+
+    uint32_t operator[](size_t k) const { return slots[k]; }
+    size_t Begin() const { return first; }
+    size_t End() const { return last; }
+    size_t Count() const { return last - first; }
+    bool Empty() const { return first == last; }
+    const uint32_t* begin() const { return slots + first; }
+    const uint32_t* end() const { return slots + last; }
+};
+
+class LaneIndex {
+private:
+    struct Bucket {
+        std::vector<uint32_t> slots;
+        uint32_t first = 0, last = 0;     // entries in [first, last)
+    };
+
+    VehicleStore& store;
+    std::vector<Bucket> lanes;
+    float firstLaneY, laneHeight;
+
+    void Place(Bucket& b, uint32_t k, uint32_t i) {
+        b.slots[k] = i;
+        store.laneSlot[i] = (int32_t)k;
+    }
+
+    // Moves the entries to the middle of a buffer of at least `size` slots
+    void Center(Bucket& b, size_t size) {
+        const uint32_t count = b.last - b.first;
+        std::vector<uint32_t> entries(b.slots.begin() + b.first, b.slots.begin() + b.last);
+        b.slots.resize(std::max(size, b.slots.size()));
+        b.first = (uint32_t)(b.slots.size() - count) / 2;
+        b.last = b.first + count;
+        for (uint32_t k = 0; k < count; k++) Place(b, b.first + k, entries[k]);
+    }
+
+public:
+    LaneIndex(VehicleStore& vehicles, int laneCount, float firstY, float height)
+        : store(vehicles), lanes(laneCount), firstLaneY(firstY), laneHeight(height) {}
+
+    int LaneCount() const { return (int)lanes.size(); }
+
+    // Any lane may end up holding the whole pool, so each bucket gets room
+    // for it on either side of the middle
+    void Reserve(uint32_t n) {
+        for (Bucket& b : lanes) Center(b, 2 * (size_t)n + 2);
+    }
+
+    // Nearest lane to a Y coordinate, clamped to the road
+    int LaneFor(float y) const {
+        int lane = (int)std::lround((y - firstLaneY) / laneHeight);
+        if (lane < 0) lane = 0;
+        if (lane >= (int)lanes.size()) lane = (int)lanes.size() - 1;
+        return lane;
+    }
+
+    LaneView Lane(int lane) const {
+        const Bucket& b = lanes[lane];
+        return LaneView(b.slots.data(), b.first, b.last);
+    }
+
+    // Bucket order is part of the model state: ties in X keep their order.
+    // Where a bucket sits in its buffer is not, so loading centres the
+    // entries and renumbers laneSlot to match.
+    template <class A> void Transfer(A& ar) {
+        uint32_t count = (uint32_t)lanes.size();
+        ar.Value(count);
+        ar.Check(count == lanes.size(), "snapshot lane count does not match the road");
+        if (count != lanes.size()) return;
+        std::vector<uint32_t> entries;
+        if (A::LOADING) for (uint32_t i = 0; i < store.Size(); i++) store.laneSlot[i] = -1;
+        for (size_t lane = 0; lane < lanes.size(); lane++) {
+            Bucket& b = lanes[lane];
+            if (!A::LOADING) entries.assign(b.slots.begin() + b.first, b.slots.begin() + b.last);
+            ar.Array(entries, store.Size());
+            if (!A::LOADING) continue;
+            if (!ar.Ok()) return;
+            b.first = b.last = 0;
+            Center(b, 2 * entries.size() + 2);
+            for (uint32_t i : entries) {
+                bool fits = i < store.Size() && store.laneIndex[i] == (int32_t)lane && store.laneSlot[i] < 0;
+                ar.Check(fits, "snapshot lane index does not agree with its vehicles");
+                if (!fits) return;
+                Place(b, b.last++, i);
+            }
+        }
+        if (!A::LOADING) return;
+        for (uint32_t i = 0; i < store.Size(); i++) {
+            ar.Check(store.laneIndex[i] < 0 || store.laneSlot[i] >= 0, "snapshot lane index does not agree with its vehicles");
+        }
+    }
+
+    // After any vehicle at the same X; the entries on the shorter side of
+    // that point shift to make room
+    void Insert(uint32_t i) {
+        int lane = LaneFor(store.targetY[i]);
+        Bucket& b = lanes[lane];
+        if (b.first == 0 || b.last == b.slots.size()) Center(b, 2 * (size_t)(b.last - b.first) + 2);
+        const float* xs = store.x.data();
+        uint32_t pos = (uint32_t)(std::upper_bound(b.slots.begin() + b.first, b.slots.begin() + b.last, xs[i],
+                                                   [xs](float x, uint32_t e) { return x < xs[e]; }) - b.slots.begin());
+        store.laneIndex[i] = lane;
+        if (pos - b.first < b.last - pos) {
+            for (uint32_t k = b.first; k < pos; k++) Place(b, k - 1, b.slots[k]);
+            b.first--;
+            Place(b, pos - 1, i);
+        } else {
+            for (uint32_t k = b.last; k > pos; k--) Place(b, k, b.slots[k - 1]);
+            b.last++;
+            Place(b, pos, i);
+        }
+    }
+
+    void Remove(uint32_t i) {
+        if (store.laneIndex[i] < 0) return;
+        Bucket& b = lanes[store.laneIndex[i]];
+        uint32_t pos = (uint32_t)store.laneSlot[i];
+        if (pos - b.first < b.last - 1 - pos) {
+            for (uint32_t k = pos; k > b.first; k--) Place(b, k, b.slots[k - 1]);
+            b.first++;
+        } else {
+            for (uint32_t k = pos + 1; k < b.last; k++) Place(b, k - 1, b.slots[k]);
+            b.last--;
+        }
+        if (b.first == b.last) b.first = b.last = (uint32_t)b.slots.size() / 2;
+        store.laneIndex[i] = -1; store.laneSlot[i] = -1;
+    }
+
+    // The store moved a vehicle to dense index i (swap-remove); repoint its entry
+    void Moved(uint32_t i) {
+        if (store.laneIndex[i] >= 0) lanes[store.laneIndex[i]].slots[store.laneSlot[i]] = i;
+    }
+
+    // Moves a vehicle to the bucket matching its current targetY, if it changed
+    void Relane(uint32_t i) {
+        if (store.laneIndex[i] == LaneFor(store.targetY[i])) return;
+        Remove(i);
+        Insert(i);
+    }
+
+    // Re-establishes X order after everyone moved. Vehicles only shift a few
+    // pixels per tick, so the buckets are nearly sorted and insertion sort
+    // runs in linear time. Lanes touch disjoint data, so different lanes may
+    // be re-sorted on different threads.
+    void ResortLane(int lane) {
+        const float* xs = store.x.data();
+        Bucket& b = lanes[lane];
+        uint32_t* bucket = b.slots.data();
+        for (uint32_t k = b.first + 1; k < b.last; k++) {
+            uint32_t v = bucket[k];
+            uint32_t j = k;
+            while (j > b.first && xs[bucket[j - 1]] > xs[v]) { bucket[j] = bucket[j - 1]; store.laneSlot[bucket[j]] = (int32_t)j; j--; }
+            bucket[j] = v; store.laneSlot[v] = (int32_t)j;
+        }
+    }
+
+    void Resort() {
+        for (int lane = 0; lane < LaneCount(); lane++) ResortLane(lane);
+    }
+
+    // First slot in a lane whose X is >= x
+    size_t LowerBound(int lane, float x) const {
+        const Bucket& b = lanes[lane];
+        size_t lo = b.first, hi = b.last;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (store.x[b.slots[mid]] < x) lo = mid + 1; else hi = mid;
+        }
+        return lo;
+    }
+};
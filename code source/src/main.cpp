@@ -1,510 +1,789 @@
 #include <raylib.h>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include <vector>
-#include <memory>
 #include <cstdlib>
 #include <ctime>
 #include <cmath>
 #include <iostream>
-
-// --- DIMENSIONS ---
-constexpr int SCREEN_WIDTH = 1600;
-constexpr int SCREEN_HEIGHT = 700;
-constexpr int WORLD_WIDTH = 4000; 
-
-constexpr int ROAD_HEIGHT = 140;
-constexpr int LANE_HEIGHT = 45;
-constexpr float VEHICLE_WIDTH = 90.0f;
-constexpr float VEHICLE_HEIGHT = 40.0f;
-constexpr float SAFE_DISTANCE = 45.0f;
-constexpr int ROAD_Y_TOP = 110;
-constexpr int ROAD_Y_BOTTOM = 280;
-
-enum AmbulanceState {
-    PATROL, TO_ACCIDENT, WAIT_AT_ACCIDENT, TO_HOSPITAL, WAIT_AT_HOSPITAL, LEAVING
-};
-
-enum BusState {
-    BUS_TO_SCHOOL, BUS_WAIT_AT_SCHOOL, BUS_LEAVING
-};
-
-// --- PROFESSIONAL TRAFFIC LIGHT UPDATE ---
-class TrafficLight {
+#include <string>
+#include <cstring>
+#include "simulation.h"
+#include "asset_pack.h"
+#include "profiler.h"
+#include "sim_thread.h"
+#include "trajectory.h"
+
+// Never run more than this many ticks in one frame; after a long stall the
+// model falls behind real time instead of freezing the window to catch up.
+constexpr int MAX_TICKS_PER_FRAME = 8;
+
+// Decoded assets turned into textures and sounds per intro frame, so the
+// uploads never hold up a frame for long
+constexpr int UPLOADS_PER_FRAME = 4;
+
+// File type raylib decodes by, e.g. ".png"
+inline const char* FileType(const char* path) {
+    const char* dot = strrchr(AssetName(path), '.');
+    return dot ? dot : "";
+}
+
+inline double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// --- SHARED TEXTURE CACHE ---
+// Each image file is decoded and uploaded to the GPU once, then shared by
+// everything that draws it. Textures stay resident until the cache is
+// destroyed with the window.
+using TextureHandle = int;
+
+class TextureCache {
 private:
-    Rectangle box;
-    float timer;
-    bool red;
-    float cycleTime;
+    struct Entry { std::string path; Texture2D texture; };
+    std::vector<Entry> entries;
+    int loadCount = 0;
+    const AssetPack* pack = nullptr;
+
+    Texture2D Load(const char* path) {
+        loadCount++;
+        const uint8_t* data;
+        size_t size;
+        if (!pack || !pack->IsOpen() || !pack->Find(AssetName(path), data, size)) return LoadTexture(path);
+        Image image = LoadImageFromMemory(FileType(path), data, (int)size);
+        Texture2D texture = LoadTextureFromImage(image);
+        UnloadImage(image);
+        return texture;
+    }
+
 public:
-    TrafficLight(float x, float y, float cycle = 5.0f)
-        : box({ x, y, 30, 80 }), timer(0.0f), red(true), cycleTime(cycle) {}
-    
-    void Update(float delta) {
-        timer += delta;
-        if (timer >= cycleTime) {
-            timer = 0.0f;
-            red = !red;
+    TextureCache() = default;
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    // Files are read from the pack when it has them, loose otherwise
+    void SetPack(const AssetPack* p) { pack = p; }
+
+    TextureHandle Acquire(const char* path) {
+        for (size_t i = 0; i < entries.size(); i++) {
+            Entry& e = entries[i];
+            if (e.path != path) continue;
+            if (e.texture.id == 0) e.texture = Load(path);
+            return (TextureHandle)i;
         }
+        entries.push_back({ path, Load(path) });
+        return (TextureHandle)(entries.size() - 1);
     }
 
-    void Draw() const {
-        Color casingColor = { 30, 30, 30, 255 };   
-        Color trimColor = { 70, 70, 70, 255 };    
-        Color offRed = { 50, 0, 0, 255 };          
-        Color offGreen = { 0, 50, 0, 255 };        
-        Color glassShine = { 255, 255, 255, 200 }; 
-
-        DrawRectangleRounded(box, 0.3f, 10, casingColor);
-        DrawRectangleRoundedLines(box, 0.3f, 3.0f, trimColor);
-
-        float centerX = box.x + box.width / 2;
-        float lightRadius = 12.0f;
-        Vector2 redPos = { centerX, box.y + box.height / 4 };
-        Vector2 greenPos = { centerX, box.y + (box.height / 4) * 3 };
-
-        DrawRectangle(box.x - 2, redPos.y - lightRadius - 5, box.width + 4, 4, trimColor);
-        DrawRectangle(box.x - 2, greenPos.y - lightRadius - 5, box.width + 4, 4, trimColor);
-
-        DrawCircleV(redPos, lightRadius, offRed);
-        DrawCircleLines((int)redPos.x, (int)redPos.y, lightRadius, BLACK);
+    // Takes over a texture uploaded elsewhere; the next Acquire of path
+    // uses it instead of loading the file again
+    void Preload(const char* path, Texture2D texture) {
+        loadCount++;
+        for (Entry& e : entries) {
+            if (e.path != path) continue;
+            if (e.texture.id == 0) e.texture = texture; else UnloadTexture(texture);
+            return;
+        }
+        entries.push_back({ path, texture });
+    }
 
-        DrawCircleV(greenPos, lightRadius, offGreen);
-        DrawCircleLines((int)greenPos.x, (int)greenPos.y, lightRadius, BLACK);
+    const Texture2D& Get(TextureHandle handle) const { return entries[handle].texture; }
 
-        if (red) {
-            DrawCircleGradient((int)redPos.x, (int)redPos.y, lightRadius * 2.5f, Fade(RED, 0.5f), Fade(RED, 0.0f));
-            DrawCircleV(redPos, lightRadius, RED);
-            DrawCircle((int)redPos.x - 4, (int)redPos.y - 4, 3.0f, glassShine);
-        } else {
-            DrawCircleGradient((int)greenPos.x, (int)greenPos.y, lightRadius * 2.5f, Fade(GREEN, 0.5f), Fade(GREEN, 0.0f));
-            DrawCircleV(greenPos, lightRadius, GREEN);
-            DrawCircle((int)greenPos.x - 4, (int)greenPos.y - 4, 3.0f, glassShine);
+    int LoadCount() const { return loadCount; }
+    int ResidentCount() const {
+        int n = 0;
+        for (const Entry& e : entries) if (e.texture.id != 0) n++;
+        return n;
+    }
+    size_t BytesResident() const {
+        size_t bytes = 0;
+        for (const Entry& e : entries) {
+            if (e.texture.id != 0) bytes += (size_t)GetPixelDataSize(e.texture.width, e.texture.height, e.texture.format);
         }
+        return bytes;
     }
 
-    bool IsRed() const { return red; }
-    float GetStopLineX(bool rightToLeft) const {
-        return rightToLeft ? (box.x - 30) : (box.x + box.width + 30);
+    ~TextureCache() {
+        for (Entry& e : entries) if (e.texture.id != 0) UnloadTexture(e.texture);
     }
 };
 
-class Vehicle {
-protected:
-    float x, y, targetY, speed;
-    Color color;
-    bool moving, ambulance, depannage, schoolBus, dirRight, changedLane, forcedStop;
-    Texture2D texture{};
+// --- BACKGROUND ASSET LOADING ---
+// Images and sounds are decoded on a worker thread while the intro screen
+// keeps drawing. The worker reads each file out of the mapped asset pack
+// (loose files when there is no pack or it lacks the file), decodes it and,
+// for atlas sprites, converts and scales it down as well. Only the main
+// thread owns the GL context, so it picks up finished assets a batch per
+// frame and does the uploads itself.
+class AssetLoader {
 public:
-    bool isCrashed, toBeRemoved;
-    bool isReckless, isAccidentTarget, isTowed, laneLock;
-    float towOffsetX;
-    Vehicle* myTower; 
-
-    Vehicle(float startX, float startY, float spd, Color col, bool dir = true, bool amb = false, bool dep = false, bool bus = false)
-        : x(startX), y(startY), targetY(startY), speed(spd), color(col), moving(true), ambulance(amb), depannage(dep), schoolBus(bus), dirRight(dir), changedLane(false), forcedStop(false), isCrashed(false), toBeRemoved(false), isReckless(false), isAccidentTarget(false), isTowed(false), laneLock(false), towOffsetX(0.0f), myTower(nullptr) {}
-    virtual ~Vehicle() { UnloadTexture(texture); }
-    
-    virtual void Update(bool stopForRed = false) {
-        if (isCrashed && !isTowed) return;
-        if (isTowed) return;
-        if (isReckless) { stopForRed = false; forcedStop = false; }
-        if (moving && !stopForRed && !forcedStop) x += dirRight ? speed : -speed;
-        if (fabs(targetY - y) > 0.5f) y += (targetY - y) * 0.08f; else y = targetY;
+    struct Asset {
+        const char* path;
+        int maxSide;            // > 0: converted to RGBA8 and scaled to fit
+        Image image;            // decoded image, or a sound's
+        Wave wave;
+        size_t bytes;           // encoded size read
+    };
+    struct Stats {
+        bool packed;
+        size_t bytesRead;
+        double openMs;          // mapping the pack
+        double decodeMs;        // worker, first asset to last
+        double uploadMs;        // main thread, all batches
+        int batches;
+        double readyMs;         // Start() to the last upload
+    };
+
+private:
+    AssetPack pack;
+    std::vector<Asset> assets;
+    std::thread worker;
+    std::atomic<size_t> decoded{ 0 };   // assets [0, decoded) are finished
+    std::atomic<bool> stopping{ false };
+    size_t collected = 0;               // assets [0, collected) are handed out
+    double workerMs = 0.0;              // written before each decoded store
+    Stats stats{};
+    std::chrono::steady_clock::time_point started;
+
+    static bool IsSound(const char* path) {
+        const char* type = FileType(path);
+        return strcmp(type, ".wav") == 0 || strcmp(type, ".ogg") == 0 || strcmp(type, ".mp3") == 0;
     }
 
-    virtual void Draw() const {
-        Rectangle source = { 0, 0, (float)texture.width, (float)texture.height };
-        Rectangle dest = { x + VEHICLE_WIDTH / 2, y + VEHICLE_HEIGHT / 2, VEHICLE_HEIGHT, VEHICLE_WIDTH };
-        Vector2 origin = { VEHICLE_HEIGHT / 2, VEHICLE_WIDTH / 2 };
-        float rotation = dirRight ? 90.0f : -90.0f;
-        DrawTexturePro(texture, source, dest, origin, rotation, isCrashed ? RED : WHITE);
+    void Decode() {
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        for (size_t k = 0; k < assets.size() && !stopping; k++) {
+            Asset& a = assets[k];
+            const uint8_t* data = nullptr;
+            size_t size = 0;
+            MappedFile loose;
+            if (!pack.IsOpen() || !pack.Find(AssetName(a.path), data, size)) {
+                if (loose.Open(a.path)) { data = loose.Data(); size = loose.Size(); }
+            }
+            if (data && IsSound(a.path)) a.wave = LoadWaveFromMemory(FileType(a.path), data, (int)size);
+            else if (data) a.image = LoadImageFromMemory(FileType(a.path), data, (int)size);
+            if (a.image.data && a.maxSide > 0) {
+                ImageFormat(&a.image, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+                int side = std::max(a.image.width, a.image.height);
+                if (side > a.maxSide) ImageResize(&a.image, a.image.width * a.maxSide / side, a.image.height * a.maxSide / side);
+            }
+            a.bytes = size;
+            workerMs = MillisecondsSince(begin);
+            decoded.store(k + 1, std::memory_order_release);
+        }
     }
-    
-    bool IsOffScreen() const { return dirRight ? x > WORLD_WIDTH + 1500 : x < -1500; }
-    bool IsAmbulance() const { return ambulance; }
-    bool IsDepannage() const { return depannage; }
-    bool IsSchoolBus() const { return schoolBus; }
-    float GetX() const { return x; }
-    float GetY() const { return y; }
-    void SetX(float newX) { x = newX; }
-    void SetY(float newY) { y = newY; }
-    void SetSpeed(float s) { speed = s; }
-    float GetSpeed() const { return speed; }
-    void SetMoving(bool state) { moving = state; }
-    bool IsMoving() const { return moving; }
-    void SetTargetY(float newY) { targetY = newY; }
-    float GetTargetY() const { return targetY; }
-    bool HasChangedLane() const { return changedLane; }
-    void SetChangedLane(bool v) { changedLane = v; }
-    void SetForcedStop(bool stop) { forcedStop = stop; }
-    bool IsForcedStop() const { return forcedStop; }
-};
 
-class Car : public Vehicle {
 public:
-    Car(float startX, float startY, float spd, Color col, bool dirRight = true, const char* imageFile = "car.png")
-        : Vehicle(startX, startY, spd, col, dirRight) { texture = LoadTexture(imageFile); }
-};
+    AssetLoader() = default;
+    AssetLoader(const AssetLoader&) = delete;
+    AssetLoader& operator=(const AssetLoader&) = delete;
+
+    // Whatever was decoded but never collected is freed here
+    ~AssetLoader() {
+        stopping = true;
+        if (worker.joinable()) worker.join();
+        for (size_t k = collected; k < decoded.load(); k++) { UnloadImage(assets[k].image); UnloadWave(assets[k].wave); }
+    }
 
-class SchoolBus : public Vehicle {
-public:
-    BusState state;
-    float stateTimer;
-    float schoolXLocation;
-    SchoolBus(float startX, float startY, float spd)
-        : Vehicle(startX, startY, spd, YELLOW, false, false, false, true), state(BUS_TO_SCHOOL), stateTimer(0.0f), schoolXLocation(WORLD_WIDTH / 2 + 100.0f) { texture = LoadTexture("school_bus.png"); }
-    void Update(bool stopForRed = false) override {
-        if (state == BUS_WAIT_AT_SCHOOL) {
-            stateTimer += GetFrameTime();
-            if (stateTimer >= 4.0f) state = BUS_LEAVING;
-        } else if (!stopForRed && !forcedStop) {
-            if (state == BUS_TO_SCHOOL) {
-                x -= speed;
-                if (x <= schoolXLocation) { x = schoolXLocation; state = BUS_WAIT_AT_SCHOOL; stateTimer = 0.0f; }
-            } else if (state == BUS_LEAVING) x -= speed;
+    // Queues a file before Start(); returns its index for Collect()
+    size_t Add(const char* path, int maxSide = 0) {
+        assets.push_back(Asset{ path, maxSide, Image{}, Wave{}, 0 });
+        return assets.size() - 1;
+    }
+
+    // Maps the pack if there is one and sets the worker going. Returns
+    // false, with the reason, when it falls back to loose files.
+    bool Start(const char* packPath, std::string& error) {
+        started = std::chrono::steady_clock::now();
+        stats.packed = pack.Open(packPath, error);
+        stats.openMs = MillisecondsSince(started);
+        worker = std::thread(&AssetLoader::Decode, this);
+        return stats.packed;
+    }
+
+    // Hands up to `batch` newly decoded assets to upload(index, asset), in
+    // the order they were added. upload() owns the image or wave from then on.
+    template <class F> void Collect(int batch, F upload) {
+        size_t ready = decoded.load(std::memory_order_acquire);
+        if (collected == ready) return;
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        for (int n = 0; n < batch && collected < ready; n++, collected++) {
+            stats.bytesRead += assets[collected].bytes;
+            upload(collected, assets[collected]);
         }
-        if (fabs(targetY - y) > 0.5f) y += (targetY - y) * 0.08f; else y = targetY;
+        stats.uploadMs += MillisecondsSince(begin);
+        stats.batches++;
+        if (!Done()) return;
+        worker.join();
+        stats.decodeMs = workerMs;
+        stats.readyMs = MillisecondsSince(started);
     }
+
+    bool Done() const { return collected == assets.size(); }
+    size_t Count() const { return assets.size(); }
+    size_t CollectedCount() const { return collected; }
+    const AssetPack& Pack() const { return pack; }
+    const Stats& GetStats() const { return stats; }
 };
 
-class Ambulance : public Vehicle {
+// Ground, asphalt and markings for every configured road. Grass lies
+// above the first road and below the last, sand between the roads. Only
+// the stretch between world X left and right is drawn, so the cost does
+// not grow with the length of the world.
+class Road {
 public:
-    AmbulanceState state;
-    float stateTimer;
-    float accidentX, accidentY;
-    Ambulance(float startX, float startY, float spd, bool dirRight = false)
-        : Vehicle(startX, startY, spd, RAYWHITE, dirRight, true), state(PATROL), stateTimer(0.0f), accidentX(0), accidentY(0) { texture = LoadTexture("ambulance.png"); }
-    void AssignAccident(float accX, float accY) { accidentX = accX; accidentY = accY; state = TO_ACCIDENT; }
-    void Update(bool stopForRed = false) override {
-        switch (state) {
-            case PATROL: Vehicle::Update(stopForRed); break;
-            case TO_ACCIDENT: 
-                if (dirRight) x += speed; else x -= speed; 
-                if (x <= accidentX + 160.0f) { x = accidentX + 160.0f; state = WAIT_AT_ACCIDENT; moving = false; stateTimer = 0.0f; } break;
-            case WAIT_AT_ACCIDENT: 
-                moving = false;
-                stateTimer += GetFrameTime(); if (stateTimer >= 5.0f) { state = TO_HOSPITAL; moving = true; } break;
-            case TO_HOSPITAL: 
-                if (!forcedStop) {
-                    if (x > 80) x -= speed; 
-                    else { state = WAIT_AT_HOSPITAL; moving = false; stateTimer = 0.0f; } 
-                }
-                break;
-            case WAIT_AT_HOSPITAL: 
-                moving = false;
-                stateTimer += GetFrameTime(); if (stateTimer >= 5.0f) { state = LEAVING; moving = true; } break;
-            case LEAVING: x -= speed; break;
+    void Draw(const WorldConfig& world, float left, float right) const {
+        const int width = (int)world.worldWidth;
+        int firstY = (int)world.roads[0].y, lastY = firstY;
+        for (const RoadConfig& r : world.roads) {
+            firstY = std::min(firstY, (int)r.y);
+            lastY = std::max(lastY, (int)(r.y + world.RoadHeight(r)));
+        }
+        int from = std::max(-5000, (int)floorf(left)), to = std::min(width + 5000, (int)ceilf(right));
+        if (from >= to) return;
+
+        DrawRectangle(from, -5000, to - from, firstY + 5000, DARKGREEN); 
+        DrawRectangle(from, lastY + 20, to - from, 5000, DARKGREEN); 
+        DrawRectangle(from, firstY, to - from, lastY + 20 - firstY, { 194, 178, 128, 255 }); 
+
+        // Dashes stay on their 80 px grid from -5000 whatever the range
+        int firstDash = -5000 + std::max(0, (from + 5000 - 40) / 80) * 80;
+        for (const RoadConfig& r : world.roads) {
+            int y = (int)r.y, height = (int)world.RoadHeight(r);
+            DrawRectangle(from, y, to - from, height, { 40, 40, 40, 255 });
+            for (int i = 1; i < r.lanes; i++) {
+                int lineY = y + (int)(i * world.laneHeight);
+                DrawLine(from, lineY, to, lineY, Fade(WHITE, 0.7f));
+            }
+            for (int i = firstDash; i < to; i += 80) {
+                DrawRectangle(i, y + (height / 2) - 3, 40, 6, YELLOW);
+            }
         }
-        if (fabs(targetY - y) > 0.5f) y += (targetY - y) * 0.08f; else y = targetY;
+        DrawRectangle(from, firstY - 20, to - from, 20, GRAY);
+        DrawRectangle(from, lastY, to - from, 20, GRAY);
     }
 };
 
-class Depannage : public Vehicle {
+// --- HOUSES ---
+// The built-in street along both verges, -1500 to 5000 px. Longer worlds
+// repeat it every HOUSE_PERIOD px up to 1000 px past their end, leaving
+// room around the hospital and the school.
+struct HousePlacement {
+    int x, y;
+    int texture;        // house.png, house1.jpg, house2.png
+};
+
+constexpr HousePlacement HOUSES[] = {
+    // Bottom
+    { -1500, 440, 1 }, { -1250, 423, 2 }, { -1020, 440, 1 }, { -850, 410, 0 }, { -600, 410, 0 }, { -250, 440, 1 },
+    { 250, 410, 0 }, { 600, 440, 1 }, { 850, 423, 2 }, { 1100, 440, 1 }, { 1400, 410, 0 }, { 2400, 440, 1 },
+    { 2600, 410, 0 }, { 2900, 440, 1 }, { 3200, 410, 0 }, { 3550, 423, 2 }, { 3850, 423, 2 }, { 4100, 423, 2 },
+    { 4300, 410, 0 }, { 4700, 440, 1 }, { 5000, 423, 2 },
+    // Top
+    { -1500, -125, 1 }, { -1250, -125, 2 }, { -1020, -125, 1 }, { -850, -145, 0 }, { -600, -145, 0 }, { -250, -125, 1 },
+    { 0, -125, 1 }, { 250, -145, 0 }, { 600, -118, 1 }, { 850, -125, 2 }, { 1100, -118, 1 }, { 1400, -145, 0 },
+    { 2050, -118, 1 }, { 2400, -118, 1 }, { 2600, -145, 0 }, { 2950, -118, 1 }, { 3200, -145, 0 }, { 3550, -125, 2 },
+    { 3850, -125, 2 }, { 4100, -125, 2 }, { 4300, -145, 0 }, { 4700, -118, 1 }, { 5000, -125, 2 },
+};
+constexpr int HOUSE_PERIOD = 6750;
+constexpr int HOUSE_MAX_WIDTH = 400;    // wider than any house texture, for culling
+
+// --- VEHICLE SPRITE ATLAS ---
+// All vehicle sprites are scaled down and packed side by side into one
+// texture at startup, so every vehicle on screen is drawn from the same
+// texture and raylib can submit them as one batch instead of switching
+// textures between cars. Sprites are packed on shelves, tallest first,
+// with a transparent gutter so bilinear filtering never bleeds between
+// neighbours.
+class SpriteAtlas {
 public:
-    bool hasPickedUp, isWorking;
-    float targetX, workTimer;
-    Depannage(float startX, float startY, float spd)
-        : Vehicle(startX, startY, spd, ORANGE, false, false, true), hasPickedUp(false), targetX(0), workTimer(0.0f), isWorking(false) { texture = LoadTexture("depannage.png"); }
-    void SetTarget(float tX) { targetX = tX; }
-    void Update(bool stopForRed = false) override {
-        if (isWorking) {
-            moving = false;
-            workTimer += GetFrameTime();
-            if (workTimer > 2.0f) { hasPickedUp = true; isWorking = false; moving = true; }
-            return;
+    static constexpr int MAX_SIDE = 256;      // vehicles never draw larger than 90 x 2 zoom
+
+private:
+    static constexpr int ATLAS_WIDTH = 1024;
+    static constexpr int PADDING = 2;
+    Texture2D texture{};
+    Rectangle sources[SPRITE_COUNT]{};
+
+public:
+    SpriteAtlas() = default;
+    SpriteAtlas(const SpriteAtlas&) = delete;
+    SpriteAtlas& operator=(const SpriteAtlas&) = delete;
+    ~SpriteAtlas() { if (texture.id != 0) UnloadTexture(texture); }
+
+    // Takes RGBA8 images no larger than MAX_SIDE, as the asset loader
+    // prepares them, and frees them. A sprite that failed to decode (no
+    // data) gets a magenta placeholder.
+    void Build(Image images[SPRITE_COUNT], const char* const paths[SPRITE_COUNT]) {
+        int order[SPRITE_COUNT];
+        for (int i = 0; i < SPRITE_COUNT; i++) {
+            if (images[i].data == nullptr) {
+                TraceLog(LOG_WARNING, "ATLAS: cannot load %s", paths[i]);
+                images[i] = GenImageColor(MAX_SIDE / 2, MAX_SIDE, MAGENTA);
+            }
+            order[i] = i;
+        }
+        std::sort(order, order + SPRITE_COUNT, [&](int a, int b) { return images[a].height > images[b].height; });
+
+        int x = PADDING, y = PADDING, shelfHeight = 0;
+        for (int k = 0; k < SPRITE_COUNT; k++) {
+            const Image& img = images[order[k]];
+            if (x + img.width + PADDING > ATLAS_WIDTH) { x = PADDING; y += shelfHeight + PADDING; shelfHeight = 0; }
+            sources[order[k]] = { (float)x, (float)y, (float)img.width, (float)img.height };
+            x += img.width + PADDING;
+            shelfHeight = std::max(shelfHeight, img.height);
+        }
+
+        Image atlas = GenImageColor(ATLAS_WIDTH, y + shelfHeight + PADDING, BLANK);
+        for (int i = 0; i < SPRITE_COUNT; i++) {
+            ImageDraw(&atlas, images[i], { 0, 0, (float)images[i].width, (float)images[i].height }, sources[i], WHITE);
+            UnloadImage(images[i]);
         }
-        if (!hasPickedUp && x <= targetX - 120) { isWorking = true; moving = false; workTimer = 0.0f; return; }
-        Vehicle::Update(stopForRed);
+        texture = LoadTextureFromImage(atlas);
+        SetTextureFilter(texture, TEXTURE_FILTER_BILINEAR);
+        UnloadImage(atlas);
     }
+
+    const Texture2D& GetTexture() const { return texture; }
+    const Rectangle& Source(int sprite) const { return sources[sprite]; }
+    size_t Bytes() const { return (size_t)GetPixelDataSize(texture.width, texture.height, texture.format); }
 };
 
-class Road {
-public:
-    void Draw() const {
-        DrawRectangle(-5000, -5000, WORLD_WIDTH + 10000, ROAD_Y_TOP + 5000, DARKGREEN); 
-        DrawRectangle(-5000, ROAD_Y_BOTTOM + ROAD_HEIGHT + 20, WORLD_WIDTH + 10000, 5000, DARKGREEN); 
+// --- BAKED SCENERY ---
+// The road, its markings, the jungle, houses, school and hospital never
+// change, so they are drawn into a row of render textures and each frame
+// only the tiles overlapping the camera's view are drawn, one textured
+// quad each. The band covers everything the camera can reach: its target
+// stays within [0, world width] and at the minimum zoom of 0.5 it sees
+// 1600 px past either end and 700 px above and below. The band stops
+// where the beach starts, at BEACH_Y; the beach and the animated sea
+// below it are drawn live each frame.
+//
+// Tiles are baked as the camera comes near them and the least recently
+// used are unloaded beyond MAX_RESIDENT, so memory and baking follow the
+// camera rather than the length of the world. Tiles in view are baked at
+// once; the neighbours on either side a few per frame.
+constexpr int BEACH_Y = 650;
+
+class SceneryTiles {
+private:
+    static constexpr int TILE_WIDTH = 1024;
+    static constexpr int FIRST_X = -2048;
+    static constexpr int TOP_Y = -350;
+    static constexpr int BOTTOM_Y = BEACH_Y;
+    static constexpr size_t MAX_RESIDENT = 8;   // the whole built-in world
+    static constexpr int PREFETCH_PER_FRAME = 1;
+
+    struct Tile {
+        int index;
+        RenderTexture2D texture;
+        uint64_t lastUsed;
+    };
+    std::vector<Tile> tiles;        // resident, in no particular order
+    int count = 0;                  // tiles the band is split into
+    uint64_t frame = 0;
+    int bakes = 0, evictions = 0;
+
+    Rectangle TileRect(int k) const {
+        return { (float)(FIRST_X + k * TILE_WIDTH), (float)TOP_Y, (float)TILE_WIDTH, (float)(BOTTOM_Y - TOP_Y) };
+    }
+
+    Tile* Find(int k) {
+        for (Tile& t : tiles) if (t.index == k) return &t;
+        return nullptr;
+    }
 
-        int gapY = ROAD_Y_TOP + ROAD_HEIGHT;
-        int gapHeight = ROAD_Y_BOTTOM - gapY;
-        DrawRectangle(-5000, gapY, WORLD_WIDTH + 10000, gapHeight, { 194, 178, 128, 255 }); 
+    // Drops the least recently used tile outside [first, last], if any
+    bool EvictOne(int first, int last) {
+        size_t victim = tiles.size();
+        for (size_t i = 0; i < tiles.size(); i++) {
+            if (tiles[i].index >= first && tiles[i].index <= last) continue;
+            if (victim == tiles.size() || tiles[i].lastUsed < tiles[victim].lastUsed) victim = i;
+        }
+        if (victim == tiles.size()) return false;
+        UnloadRenderTexture(tiles[victim].texture);
+        tiles[victim] = tiles.back();
+        tiles.pop_back();
+        evictions++;
+        return true;
+    }
 
-        DrawRectangle(-5000, ROAD_Y_TOP, WORLD_WIDTH + 10000, ROAD_HEIGHT, { 40, 40, 40, 255 });
-        DrawRectangle(-5000, ROAD_Y_BOTTOM, WORLD_WIDTH + 10000, ROAD_HEIGHT, { 40, 40, 40, 255 });
+    template <class Painter> void Bake(int k, Painter& paint) {
+        Rectangle r = TileRect(k);
+        RenderTexture2D texture = LoadRenderTexture((int)r.width, (int)r.height);
+        Camera2D cam = { 0 };
+        cam.target = { r.x, r.y };
+        cam.zoom = 1.0f;
+        BeginTextureMode(texture);
+        ClearBackground(BLANK);
+        BeginMode2D(cam);
+        paint(r);
+        EndMode2D();
+        EndTextureMode();
+        tiles.push_back({ k, texture, frame });
+        bakes++;
+    }
+
+public:
+    SceneryTiles() = default;
+    SceneryTiles(const SceneryTiles&) = delete;
+    SceneryTiles& operator=(const SceneryTiles&) = delete;
+    ~SceneryTiles() {
+        for (Tile& t : tiles) UnloadRenderTexture(t.texture);
+    }
 
-        for (int i = 1; i < 3; i++) {
-            DrawLine(-5000, ROAD_Y_TOP + i * LANE_HEIGHT, WORLD_WIDTH + 5000, ROAD_Y_TOP + i * LANE_HEIGHT, Fade(WHITE, 0.7f));
-            DrawLine(-5000, ROAD_Y_BOTTOM + i * LANE_HEIGHT, WORLD_WIDTH + 5000, ROAD_Y_BOTTOM + i * LANE_HEIGHT, Fade(WHITE, 0.7f));
+    void SetWorld(int worldWidth) { count = (worldWidth - 2 * FIRST_X + TILE_WIDTH - 1) / TILE_WIDTH; }
+
+    // paint(area) draws the static layers that overlap `area`, in world
+    // coordinates, with the camera pointed at that tile. Must be called
+    // outside BeginDrawing()/EndDrawing(), since baking switches the
+    // render target.
+    template <class Painter> void Stream(Rectangle view, Painter paint) {
+        frame++;
+        int first = std::max(0, (int)floorf((view.x - FIRST_X) / TILE_WIDTH));
+        int last = std::min(count - 1, (int)floorf((view.x + view.width - FIRST_X) / TILE_WIDTH));
+        for (int k = first; k <= last; k++) {
+            if (Tile* t = Find(k)) { t->lastUsed = frame; continue; }
+            if (tiles.size() >= MAX_RESIDENT) EvictOne(first, last);
+            Bake(k, paint);
         }
-        DrawRectangle(-5000, ROAD_Y_TOP - 20, WORLD_WIDTH + 10000, 20, GRAY);
-        DrawRectangle(-5000, ROAD_Y_BOTTOM + ROAD_HEIGHT, WORLD_WIDTH + 10000, 20, GRAY);
-        for (int i = -5000; i < WORLD_WIDTH + 5000; i += 80) {
-            DrawRectangle(i, ROAD_Y_TOP + (ROAD_HEIGHT / 2) - 3, 40, 6, YELLOW);
-            DrawRectangle(i, ROAD_Y_BOTTOM + (ROAD_HEIGHT / 2) - 3, 40, 6, YELLOW);
+        // One tile either side, so panning rarely waits for a bake
+        int prefetched = 0;
+        for (int k : { last + 1, first - 1 }) {
+            if (k < 0 || k >= count || Find(k) || prefetched == PREFETCH_PER_FRAME) continue;
+            if (tiles.size() >= MAX_RESIDENT && !EvictOne(first - 1, last + 1)) continue;
+            Bake(k, paint);
+            prefetched++;
         }
     }
-};
 
-struct Accident { bool active, pending; float x, y; Vehicle* car1; Vehicle* car2; };
+    // Returns how many tiles were drawn
+    int Draw(Rectangle view) const {
+        int drawn = 0;
+        for (const Tile& t : tiles) {
+            Rectangle r = TileRect(t.index);
+            if (!CheckCollisionRecs(r, view)) continue;
+            // Render textures are stored upside down; a negative source height flips them back
+            DrawTextureRec(t.texture.texture, { 0.0f, 0.0f, r.width, -r.height }, { r.x, r.y }, WHITE);
+            drawn++;
+        }
+        return drawn;
+    }
 
-class Simulation {
+    int TileCount() const { return count; }
+    int ResidentCount() const { return (int)tiles.size(); }
+    int BakeCount() const { return bakes; }
+    int EvictionCount() const { return evictions; }
+    static size_t TileBytes() { return (size_t)TILE_WIDTH * (BOTTOM_Y - TOP_Y) * 4; }
+    size_t BytesResident() const { return tiles.size() * TileBytes(); }
+    static size_t MaxBytes() { return MAX_RESIDENT * TileBytes(); }
+};
+
+// --- WINDOW FRONT END ---
+// Owns everything that needs a raylib window: camera, input, textures,
+// audio and drawing. The traffic model itself lives in simulation.h.
+class Viewer {
 private:
     Camera2D camera = { 0 }; 
-    std::vector<std::unique_ptr<Vehicle>> vehiclesTop;
-    std::vector<std::unique_ptr<Vehicle>> vehiclesBottom;
-    TrafficLight lightTop, lightBottom;
+    TextureCache textures;
     Road road;
+    WorldConfig world;
+    SceneryTiles scenery;
     
     Texture2D hospitalTexture{}, schoolTexture{}, houseTextures[3]{}, jungleTexture{}, seaTexture{};
 
-    float laneYTop[3], laneYBottom[3];
-    float carSpawnTimerTop, carSpawnTimerBottom;
-    const char* carImages[5] = { "car.png", "cars.png", "car2.png", "car3.png", "car4.png" };
+    const char* spriteImages[SPRITE_COUNT] = { "car.png", "cars.png", "car2.png", "car3.png", "car4.png", "ambulance.png", "depannage.png", "school_bus.png" };
+    const char* sirenSound = "siren.wav";
+    SpriteAtlas atlas;
+    TextureHandle hospitalHandle = -1, schoolHandle = -1, houseHandles[3]{}, jungleHandle = -1, seaHandle = -1;
     Sound siren{};
-    bool ambulanceActive = false, screenAlertOn = false, waitingForTowToLeave = false;
+    AssetLoader assets;
+    Image sprites[SPRITE_COUNT]{};   // decoded, waiting for the atlas
+    size_t sirenAsset = 0;
+    bool loaded = false;
+    bool screenAlertOn = false;
     float screenAlertTimer = 0.0f;
-    Accident currentAccident;
-
-public:
-    Simulation() : lightTop(WORLD_WIDTH / 2 - 80, ROAD_Y_TOP - 100, 5.0f), lightBottom(WORLD_WIDTH / 2 - 150, ROAD_Y_BOTTOM + ROAD_HEIGHT + 20, 5.0f), carSpawnTimerTop(0.0f), carSpawnTimerBottom(0.0f) {
-        for (int i = 0; i < 3; i++) { laneYTop[i] = (float)ROAD_Y_TOP + 10.0f + i * (float)LANE_HEIGHT; laneYBottom[i] = (float)ROAD_Y_BOTTOM + 10.0f + i * (float)LANE_HEIGHT; }
-        currentAccident = { false, false, 0, 0, nullptr, nullptr };
+    float alpha = 1.0f;     // how far the frame is between the last two ticks, set by Draw()
+    bool paused = false;
+    float timeScale = 1.0f; // simulated seconds per real second
+    std::vector<uint8_t> playbackLights;
+    std::vector<TrajectoryIncident> playbackIncidents;
+#ifdef TRAFFIC_PROFILE
+    bool showProfiler = false;
+#endif
+
+    // Runs once every asset is on the GPU: the atlas and the baked scenery
+    // need all of theirs at once
+    void FinishLoading() {
+        atlas.Build(sprites, spriteImages);
+        TraceLog(LOG_INFO, "ATLAS: %d sprites in %dx%d, %zu bytes", SPRITE_COUNT, atlas.GetTexture().width, atlas.GetTexture().height, atlas.Bytes());
+
+        hospitalHandle = textures.Acquire("hospital.png");
+        schoolHandle = textures.Acquire("school.png");
+        houseHandles[0] = textures.Acquire("house.png");
+        houseHandles[1] = textures.Acquire("house1.jpg");
+        houseHandles[2] = textures.Acquire("house2.png");
+        jungleHandle = textures.Acquire("jungle.png");
+        seaHandle = textures.Acquire("sea.png");
+        hospitalTexture = textures.Get(hospitalHandle);
+        schoolTexture = textures.Get(schoolHandle);
+        for (int i = 0; i < 3; i++) houseTextures[i] = textures.Get(houseHandles[i]);
+        jungleTexture = textures.Get(jungleHandle);
+        seaTexture = textures.Get(seaHandle);
+        TraceLog(LOG_INFO, "TEXTURES: %d loaded, %zu bytes resident", textures.LoadCount(), textures.BytesResident());
+
+        scenery.SetWorld((int)world.worldWidth);
+        TraceLog(LOG_INFO, "SCENERY: %d tiles, baked near the camera, at most %zu bytes resident", scenery.TileCount(), SceneryTiles::MaxBytes());
+
+        const AssetLoader::Stats& st = assets.GetStats();
+        TraceLog(LOG_INFO, "ASSETS: %d files, %zu bytes read from %s (opened in %.2f ms)", (int)assets.Count(), st.bytesRead,
+                 st.packed ? "the asset pack" : "loose files", st.openMs);
+        TraceLog(LOG_INFO, "ASSETS: decoded in %.1f ms on the worker, uploaded in %.1f ms over %d frames, ready %.1f ms after start",
+                 st.decodeMs, st.uploadMs, st.batches, st.readyMs);
+        loaded = true;
     }
 
-    void Init() {
-        siren = LoadSound("siren.wav");
-        srand((unsigned int)time(nullptr));
-        
-        hospitalTexture = LoadTexture("hospital.png");
-        schoolTexture = LoadTexture("school.png");
-        houseTextures[0] = LoadTexture("house.png");
-        houseTextures[1] = LoadTexture("house1.jpg");
-        houseTextures[2] = LoadTexture("house2.png");
-        jungleTexture = LoadTexture("jungle.png");
-        seaTexture = LoadTexture("sea.png");
-
-        camera.target = { WORLD_WIDTH / 2.0f, SCREEN_HEIGHT / 2.0f };
+public:
+    // Sets the asset worker going; the intro screen then calls
+    // ContinueLoading() every frame until everything is in
+    void Init(const WorldConfig& cfg, const char* packPath) {
+        world = cfg;
+        for (int i = 0; i < SPRITE_COUNT; i++) assets.Add(spriteImages[i], SpriteAtlas::MAX_SIDE);
+        for (const char* path : { "hospital.png", "school.png", "house.png", "house1.jpg", "house2.png", "jungle.png", "sea.png" }) assets.Add(path);
+        sirenAsset = assets.Add(sirenSound);
+        std::string error;
+        if (!assets.Start(packPath, error)) TraceLog(LOG_WARNING, "ASSETS: %s, reading loose files", error.c_str());
+        textures.SetPack(&assets.Pack());
+
+        camera.target = { world.worldWidth / 2.0f, SCREEN_HEIGHT / 2.0f };
         camera.offset = { SCREEN_WIDTH / 2.0f, SCREEN_HEIGHT / 2.0f };
         camera.rotation = 0.0f;
         camera.zoom = 1.0f;
     }
 
-    void SpawnCarTop() {
-        int lane = GetRandomValue(0, 2);
-        float speed = 2.0f + GetRandomValue(0, 5) / 10.0f;
-        Color c = { (unsigned char)GetRandomValue(80, 255), (unsigned char)GetRandomValue(80, 255), (unsigned char)GetRandomValue(80, 255), 255 };
-        vehiclesTop.push_back(std::make_unique<Car>(-1500, laneYTop[lane], speed, c, true, carImages[GetRandomValue(0, 4)]));
-    }
-    void SpawnCarBottom() {
-        int lane = GetRandomValue(0, 2);
-        float speed = 2.0f + GetRandomValue(0, 5) / 10.0f; 
-        Color c = { (unsigned char)GetRandomValue(80, 255), (unsigned char)GetRandomValue(80, 255), (unsigned char)GetRandomValue(80, 255), 255 };
-        vehiclesBottom.push_back(std::make_unique<Car>(WORLD_WIDTH + 1500, laneYBottom[lane], speed, c, false, carImages[GetRandomValue(0, 4)]));
-    }
-    void CallSchoolBus() { vehiclesBottom.push_back(std::make_unique<SchoolBus>(WORLD_WIDTH + 1500, laneYBottom[2], 2.5f)); }
-
-    void TriggerRandomAccident() {
-        if (waitingForTowToLeave) return; 
-        if (currentAccident.active || currentAccident.pending) return;
-        for (size_t i = 0; i < vehiclesBottom.size(); i++) {
-            Vehicle* v1 = vehiclesBottom[i].get(); 
-            if (v1->IsAmbulance() || v1->IsDepannage() || v1->IsSchoolBus() || v1->IsOffScreen()) continue;
-            if (v1->isTowed || v1->isCrashed) continue;
-            if (fabs(v1->GetTargetY() - laneYBottom[2]) < 5.0f) continue;
-            for (size_t j = 0; j < vehiclesBottom.size(); j++) {
-                if (i == j) continue;
-                Vehicle* v2 = vehiclesBottom[j].get(); 
-                if (v2->IsAmbulance() || v2->IsDepannage() || v2->IsSchoolBus() || v2->IsOffScreen()) continue;
-                if (v2->isTowed || v2->isCrashed) continue;
-                if (fabs(v1->GetTargetY() - v2->GetTargetY()) < 5.0f) {
-                    if (v1->GetX() > v2->GetX()) {
-                        float dist = v1->GetX() - v2->GetX();
-                        if (dist < 400 && dist > 110 && v1->GetX() < WORLD_WIDTH - 100 && v2->GetX() > 100) {
-                            currentAccident.pending = true; currentAccident.car1 = v2; currentAccident.car2 = v1; waitingForTowToLeave = true;
-                            v1->isReckless = true; v2->isAccidentTarget = true; v1->laneLock = true; v2->laneLock = true; 
-                            v1->SetSpeed(v1->GetSpeed() * 2.8f); v2->SetSpeed(v2->GetSpeed() * 0.4f);
-                            return;
-                        }
-                    }
-                }
-            }
-        }
+    // Bakes the scenery tiles the camera is coming up to; call it every
+    // frame before BeginDrawing()
+    void StreamScenery() {
+        if (!loaded) return;
+        PROFILE_SCOPE("frame.scenery");
+        scenery.Stream(VisibleRect(), [this](Rectangle area) { DrawStaticScenery(area); });
     }
-    void CallAmbulance() {
-        if (!currentAccident.active && !currentAccident.pending) TriggerRandomAccident(); 
-        PlaySound(siren);
-        auto amb = std::make_unique<Ambulance>(WORLD_WIDTH + 1500, laneYBottom[1], 4.5f, false);
-        if (currentAccident.active) { amb->AssignAccident(currentAccident.x, currentAccident.y); amb->SetTargetY(currentAccident.y); }
-        vehiclesBottom.push_back(std::move(amb)); ambulanceActive = true;
-    }
-    void CallDepannage() {
-        if (!currentAccident.active) return;
-        auto tow = std::make_unique<Depannage>(WORLD_WIDTH + 1500, currentAccident.y, 2.5f);
-        tow->SetTarget(currentAccident.x); vehiclesBottom.push_back(std::move(tow));
+
+    // Uploads the next batch of decoded assets; true once all are loaded
+    bool ContinueLoading() {
+        if (loaded) return true;
+        assets.Collect(UPLOADS_PER_FRAME, [this](size_t k, AssetLoader::Asset& a) {
+            if (k < SPRITE_COUNT) { sprites[k] = a.image; return; }
+            if (k == sirenAsset) {
+                if (a.wave.data) siren = LoadSoundFromWave(a.wave); else TraceLog(LOG_WARNING, "ASSETS: cannot load %s", a.path);
+                UnloadWave(a.wave);
+                return;
+            }
+            if (!a.image.data) { TraceLog(LOG_WARNING, "ASSETS: cannot load %s", a.path); return; }
+            textures.Preload(a.path, LoadTextureFromImage(a.image));
+            UnloadImage(a.image);
+        });
+        if (assets.Done()) FinishLoading();
+        return loaded;
     }
 
-    void Update(float delta) {
+    void HandleCameraInput() {
         float wheel = GetMouseWheelMove();
         if (wheel != 0) { camera.zoom += wheel * 0.1f; if (camera.zoom < 0.5f) camera.zoom = 0.5f; if (camera.zoom > 2.0f) camera.zoom = 2.0f; }
         if (IsKeyDown(KEY_RIGHT) || (IsMouseButtonDown(MOUSE_BUTTON_RIGHT) && GetMouseDelta().x < 0)) camera.target.x += 15.0f / camera.zoom;
         if (IsKeyDown(KEY_LEFT) || (IsMouseButtonDown(MOUSE_BUTTON_RIGHT) && GetMouseDelta().x > 0)) camera.target.x -= 15.0f / camera.zoom;
-        if (camera.target.x < 0) camera.target.x = 0; if (camera.target.x > WORLD_WIDTH) camera.target.x = WORLD_WIDTH;
-
-        carSpawnTimerTop += delta; if (carSpawnTimerTop >= GetRandomValue(40, 70) / 10.0f) { carSpawnTimerTop = 0.0f; SpawnCarTop(); } 
-        carSpawnTimerBottom += delta; if (carSpawnTimerBottom >= GetRandomValue(40, 70) / 10.0f) { carSpawnTimerBottom = 0.0f; SpawnCarBottom(); }
-        if (GetRandomValue(0, 1000) < 5) TriggerRandomAccident();
-        lightTop.Update(delta); lightBottom.Update(delta);
-
-        vehiclesTop.erase(std::remove_if(vehiclesTop.begin(), vehiclesTop.end(), [](const std::unique_ptr<Vehicle>& v) { return v->IsOffScreen(); }), vehiclesTop.end());
-        vehiclesBottom.erase(std::remove_if(vehiclesBottom.begin(), vehiclesBottom.end(), [&](const std::unique_ptr<Vehicle>& v) { 
-            if (v->IsDepannage()) { bool despawn = v->GetX() < -3000.0f; if (despawn) waitingForTowToLeave = false; return despawn; }
-            if (v->IsSchoolBus()) return v->IsOffScreen();
-            if (v->isReckless || v->isAccidentTarget || v->isCrashed || v->isTowed) {
-                if (v->GetX() > -2000.0f && !v->toBeRemoved) return false;
-                if (v.get() == currentAccident.car1) currentAccident.car1 = nullptr; if (v.get() == currentAccident.car2) currentAccident.car2 = nullptr;
-                if (v->isAccidentTarget || v->isReckless || v->isCrashed) { currentAccident.pending = false; currentAccident.active = false; } return true;
-            }
-            if (v->IsOffScreen() || v->toBeRemoved) {
-                if (v.get() == currentAccident.car1 || v.get() == currentAccident.car2) { currentAccident.car1 = nullptr; currentAccident.car2 = nullptr; currentAccident.pending = false; currentAccident.active = false; waitingForTowToLeave = false; } return true;
-            } return false;
-        }), vehiclesBottom.end());
-
-        if (currentAccident.pending && currentAccident.car1 && currentAccident.car2) {
-            float dist = currentAccident.car2->GetX() - currentAccident.car1->GetX();
-            if (dist < VEHICLE_WIDTH - 10.0f && dist > -VEHICLE_WIDTH) {
-                currentAccident.pending = false; currentAccident.active = true; currentAccident.car1->isCrashed = true; currentAccident.car2->isCrashed = true;
-                currentAccident.car2->isReckless = false; currentAccident.car1->SetMoving(false); currentAccident.car2->SetMoving(false);
-                currentAccident.x = currentAccident.car1->GetX() + (VEHICLE_WIDTH/2); currentAccident.y = currentAccident.car1->GetY();
-                for (auto& v : vehiclesBottom) { if (v->IsAmbulance()) { static_cast<Ambulance*>(v.get())->AssignAccident(currentAccident.x, currentAccident.y); v->SetTargetY(currentAccident.y); } }
-            }
-        } else if (currentAccident.pending) { currentAccident.pending = false; waitingForTowToLeave = false; }
+        if (camera.target.x < 0) camera.target.x = 0;
+        if (camera.target.x > world.worldWidth) camera.target.x = world.worldWidth;
+    }
 
-        Ambulance* activeAmbulance = nullptr; Depannage* activeTow = nullptr;
-        for (auto& v : vehiclesBottom) { if (v->IsAmbulance()) activeAmbulance = static_cast<Ambulance*>(v.get()); if (v->IsDepannage()) activeTow = static_cast<Depannage*>(v.get()); }
+    // P pauses, - and = halve and double the speed. The model only ever
+    // advances in whole ticks, so lights, waits and vehicles all slow down
+    // or stop together.
+    void HandleClockInput() {
+        if (IsKeyPressed(KEY_P)) paused = !paused;
+        if (IsKeyPressed(KEY_MINUS) && timeScale > 0.25f) timeScale *= 0.5f;
+        if (IsKeyPressed(KEY_EQUAL) && timeScale < 4.0f) timeScale *= 2.0f;
+    }
+    bool IsPaused() const { return paused; }
+    float TimeScale() const { return timeScale; }
 
-        if (activeTow && activeTow->hasPickedUp && currentAccident.active) {
-            if (currentAccident.car1) { currentAccident.car1->isTowed = true; currentAccident.car1->isCrashed = false; currentAccident.car1->isAccidentTarget = false; currentAccident.car1->towOffsetX = 100.0f; currentAccident.car1->myTower = activeTow; currentAccident.car1->SetY(activeTow->GetY()); }
-            if (currentAccident.car2) { currentAccident.car2->isTowed = true; currentAccident.car2->isCrashed = false; currentAccident.car2->towOffsetX = 200.0f; currentAccident.car2->myTower = activeTow; currentAccident.car2->SetY(activeTow->GetY()); }
-            currentAccident.active = false; 
-        }
-        for (auto& v : vehiclesBottom) { if (v->isTowed && v->myTower != nullptr) { v->SetX(v->myTower->GetX() + v->towOffsetX); v->SetY(v->myTower->GetY()); } }
-
-        if (activeAmbulance) { if (activeAmbulance->state == TO_HOSPITAL) activeAmbulance->SetTargetY(laneYBottom[2]); else if (activeAmbulance->state == TO_ACCIDENT && currentAccident.active) activeAmbulance->SetTargetY(currentAccident.y); }
-
-        for (size_t i = 0; i < vehiclesBottom.size(); ++i) {
-            auto& v = vehiclesBottom[i]; if (v->isCrashed || v->isTowed) continue; 
-            
-            if (!v->isReckless && !v->laneLock && !v->HasChangedLane()) {
-                auto tryYield = [&](Vehicle* emergencyVehicle) {
-                    if (emergencyVehicle) { 
-                         if (fabs(v->GetTargetY() - emergencyVehicle->GetTargetY()) < 5.0f) {
-                             float dist = emergencyVehicle->GetX() - v->GetX();
-                             if (dist > 0 && dist < 450.0f) { 
-                                 int currentLaneIdx = 0; if (fabs(v->GetY() - laneYBottom[1]) < 5) currentLaneIdx = 1; if (fabs(v->GetY() - laneYBottom[2]) < 5) currentLaneIdx = 2;
-                                 int targetLane = (currentLaneIdx + 1) % 3; v->SetTargetY(laneYBottom[targetLane]); v->SetChangedLane(true);
-                             }
-                          }
-                    }
-                };
-                tryYield(activeAmbulance); if (activeTow && activeTow->isWorking) tryYield(activeTow); 
-            }
+    void UpdateAlert(const WorldFrame& frame, float delta) {
+        if (frame.ambulanceActive) { screenAlertTimer += delta; if (screenAlertTimer >= 0.5f) { screenAlertOn = !screenAlertOn; screenAlertTimer = 0.0f; } } else { screenAlertOn = false; }
+    }
 
-            bool stop = false;
-            if (!v->isReckless) {
-                if (currentAccident.active && !v->HasChangedLane() && !v->laneLock) {
-                    if (fabs(v->GetY() - currentAccident.y) < 5.0f && v->GetX() > currentAccident.x) {
-                        if (v->GetX() - currentAccident.x < 300) {
-                            int currentLaneIdx = 0; if (fabs(v->GetY() - laneYBottom[1]) < 5) currentLaneIdx = 1; if (fabs(v->GetY() - laneYBottom[2]) < 5) currentLaneIdx = 2;
-                            int targetLane = (currentLaneIdx + 1) % 3; v->SetTargetY(laneYBottom[targetLane]); v->SetChangedLane(true);
-                        }
-                    }
-                }
-                float stopX = lightBottom.GetStopLineX(true);
-                if (!v->IsAmbulance() && lightBottom.IsRed() && fabs(v->GetX() - stopX) < 50) stop = true;
-                
-                if (!stop) {
-                    for (size_t j = 0; j < vehiclesBottom.size(); ++j) {
-                        if (i == j) continue; auto& other = vehiclesBottom[j]; if (other->isTowed) continue; 
-                        if (v->IsDepannage() && (other->isCrashed || other->isAccidentTarget)) continue;
-                        
-                        if (fabs(v->GetTargetY() - other->GetTargetY()) < 5.0f) {
-                            if (other->GetX() < v->GetX()) { 
-                                float frontOfOther = other->GetX() + VEHICLE_WIDTH; 
-                                float distToFront = v->GetX() - frontOfOther;
-                                float limit = SAFE_DISTANCE;
-                                
-                                if (v->IsAmbulance()) {
-                                    limit = 10.0f;
-                                } else if (other->IsDepannage()) {
-                                    limit = 250.0f; 
-                                } else if (other->IsAmbulance() && !other->IsMoving()) {
-                                     limit = 150.0f; 
-                                }
-
-                                if (distToFront < limit) { stop = true; break; }
-                            }
-                        }
-                    }
-                }
-            } 
-            v->SetForcedStop(stop); v->Update(stop);
+    void PlaySiren() { PlaySound(siren); }
+
+    void DrawTrafficLight(float x, float y, bool red) const {
+        Rectangle box = { x, y, TrafficLight::WIDTH, TrafficLight::HEIGHT };
+        Color casingColor = { 30, 30, 30, 255 };   
+        Color trimColor = { 70, 70, 70, 255 };    
+        Color offRed = { 50, 0, 0, 255 };          
+        Color offGreen = { 0, 50, 0, 255 };        
+        Color glassShine = { 255, 255, 255, 200 }; 
+
+        DrawRectangleRounded(box, 0.3f, 10, casingColor);
+        DrawRectangleRoundedLines(box, 0.3f, 3.0f, trimColor);
+
+        float centerX = box.x + box.width / 2;
+        float lightRadius = 12.0f;
+        Vector2 redPos = { centerX, box.y + box.height / 4 };
+        Vector2 greenPos = { centerX, box.y + (box.height / 4) * 3 };
+
+        DrawRectangle(box.x - 2, redPos.y - lightRadius - 5, box.width + 4, 4, trimColor);
+        DrawRectangle(box.x - 2, greenPos.y - lightRadius - 5, box.width + 4, 4, trimColor);
+
+        DrawCircleV(redPos, lightRadius, offRed);
+        DrawCircleLines((int)redPos.x, (int)redPos.y, lightRadius, BLACK);
+
+        DrawCircleV(greenPos, lightRadius, offGreen);
+        DrawCircleLines((int)greenPos.x, (int)greenPos.y, lightRadius, BLACK);
+
+        if (red) {
+            DrawCircleGradient((int)redPos.x, (int)redPos.y, lightRadius * 2.5f, Fade(RED, 0.5f), Fade(RED, 0.0f));
+            DrawCircleV(redPos, lightRadius, RED);
+            DrawCircle((int)redPos.x - 4, (int)redPos.y - 4, 3.0f, glassShine);
+        } else {
+            DrawCircleGradient((int)greenPos.x, (int)greenPos.y, lightRadius * 2.5f, Fade(GREEN, 0.5f), Fade(GREEN, 0.0f));
+            DrawCircleV(greenPos, lightRadius, GREEN);
+            DrawCircle((int)greenPos.x - 4, (int)greenPos.y - 4, 3.0f, glassShine);
         }
+    }
 
-        for (size_t i = 0; i < vehiclesTop.size(); ++i) {
-             auto& v = vehiclesTop[i]; bool stop = false;
-             if (lightTop.IsRed() && fabs(v->GetX() - lightTop.GetStopLineX(false)) < 50) stop = true;
-             if (!stop) {
-                 for (size_t j = 0; j < vehiclesTop.size(); ++j) {
-                     if (i == j) continue; if (vehiclesTop[j]->GetTargetY() == v->GetTargetY() && vehiclesTop[j]->GetX() > v->GetX()) { if (vehiclesTop[j]->GetX() - VEHICLE_WIDTH - v->GetX() < SAFE_DISTANCE) { stop = true; break; } }
-                 }
-             }
-             v->SetForcedStop(stop); v->Update(stop);
+    // World-space rectangle the camera currently shows
+    Rectangle VisibleRect() const {
+        Vector2 a = GetScreenToWorld2D({ 0.0f, 0.0f }, camera);
+        Vector2 b = GetScreenToWorld2D({ (float)SCREEN_WIDTH, (float)SCREEN_HEIGHT }, camera);
+        return { a.x, a.y, b.x - a.x, b.y - a.y };
+    }
+
+    // One pass over all roads, every quad from the atlas texture, so the
+    // whole traffic goes out in as few draw calls as raylib's batch allows
+    void DrawVehicles(const WorldFrame& frame, Rectangle view) const {
+        PROFILE_SCOPE("draw.vehicles");
+        const Texture2D& texture = atlas.GetTexture();
+        const Vector2 origin = { VEHICLE_HEIGHT / 2, VEHICLE_WIDTH / 2 };
+        for (const FrameVehicle& v : frame.vehicles) {
+            float x = v.prevX + (v.x - v.prevX) * alpha;
+            float y = v.prevY + (v.y - v.prevY) * alpha;
+            // Sprites are drawn rotated, so allow a full length of margin on every side
+            if (x + VEHICLE_WIDTH < view.x || x - VEHICLE_WIDTH > view.x + view.width) continue;
+            if (y + VEHICLE_WIDTH < view.y || y - VEHICLE_WIDTH > view.y + view.height) continue;
+            Rectangle dest = { x + VEHICLE_WIDTH / 2, y + VEHICLE_HEIGHT / 2, VEHICLE_HEIGHT, VEHICLE_WIDTH };
+            float rotation = (v.flags & VF_DIR_RIGHT) ? 90.0f : -90.0f;
+            DrawTexturePro(texture, atlas.Source(v.sprite), dest, origin, rotation, (v.flags & VF_CRASHED) ? RED : WHITE);
         }
+    }
 
-        ambulanceActive = (activeAmbulance != nullptr);
-        if (ambulanceActive) { screenAlertTimer += delta; if (screenAlertTimer >= 0.5f) { screenAlertOn = !screenAlertOn; screenAlertTimer = 0.0f; } } else { screenAlertOn = false; }
+    // Same pass for a recorded frame, straight out of the mapped file
+    void DrawRecordedVehicles(const TrajectoryFile::Frame& frame, Rectangle view) const {
+        PROFILE_SCOPE("draw.vehicles");
+        const Texture2D& texture = atlas.GetTexture();
+        const Vector2 origin = { VEHICLE_HEIGHT / 2, VEHICLE_WIDTH / 2 };
+        for (uint32_t i = 0; i < frame.vehicleCount; i++) {
+            const TrajectoryVehicle& v = frame.vehicles[i];
+            if (v.x + VEHICLE_WIDTH < view.x || v.x - VEHICLE_WIDTH > view.x + view.width) continue;
+            if (v.y + VEHICLE_WIDTH < view.y || v.y - VEHICLE_WIDTH > view.y + view.height) continue;
+            Rectangle dest = { v.x + VEHICLE_WIDTH / 2, v.y + VEHICLE_HEIGHT / 2, VEHICLE_HEIGHT, VEHICLE_WIDTH };
+            float rotation = (v.flags & VF_DIR_RIGHT) ? 90.0f : -90.0f;
+            DrawTexturePro(texture, atlas.Source(v.sprite), dest, origin, rotation, (v.flags & VF_CRASHED) ? RED : WHITE);
+        }
     }
 
-    void DrawWorld() const {
-        road.Draw();
-        
+    // Everything baked into the scenery tiles, as far as it overlaps `area`
+    void DrawStaticScenery(Rectangle area) const {
+        const float left = area.x, right = area.x + area.width;
+        road.Draw(world, left, right);
+
         if (jungleTexture.id != 0) {
             int jWidth = jungleTexture.width; if (jWidth == 0) jWidth = 100;
             float jHeight = (float)jungleTexture.height;
-            for (int i = -2000; i < WORLD_WIDTH + 2000; i += jWidth) {
+            int from = -2000 + std::max(0, ((int)left - jWidth + 2000) / jWidth) * jWidth;
+            for (int i = from; i < (int)world.worldWidth + 2000 && i < right; i += jWidth) {
                 Rectangle source = { 0.0f, 0.0f, (float)jWidth, jHeight };
                 Rectangle destTop = { (float)i, -450.0f, (float)jWidth, 350.0f };
                 DrawTexturePro(jungleTexture, source, destTop, {0,0}, 0.0f, WHITE);
             }
         }
 
-        if (seaTexture.id != 0) {
-            int sWidth = seaTexture.width; if (sWidth == 0) sWidth = 100;
-            float sHeight = (float)seaTexture.height;
-            float time = (float)GetTime();
-            
-            DrawRectangle(-2000, 650, WORLD_WIDTH + 4000, 500, { 237, 201, 175, 255 }); 
-
-            for (int i = -2000; i < WORLD_WIDTH + 2000; i += sWidth) {
-                bool flip = ((i / sWidth) % 2 != 0); 
-                float widthFactor = flip ? -1.0f : 1.0f;
-                float waveY = sinf(time * 2.0f + (i * 0.005f)) * 5.0f;
-                Rectangle source = { 0.0f, 0.0f, (float)sWidth * widthFactor, sHeight };
-                Rectangle destBot = { (float)i, 700.0f + waveY, (float)sWidth, 350.0f };
-                DrawTexturePro(seaTexture, source, destBot, {0,0}, 0.0f, WHITE);
+        const RoadConfig& incident = world.roads[world.IncidentRoad()];
+        DrawTexture(hospitalTexture, (int)world.hospitalX - 70, (int)(incident.y + world.RoadHeight(incident)) + 10, WHITE);
+        DrawHouses(left, right);
+    }
+
+    // The beach and the animated sea below the baked band
+    void DrawSea(Rectangle view) const {
+        PROFILE_SCOPE("draw.sea");
+        DrawRectangle(-2000, BEACH_Y, (int)world.worldWidth + 4000, 500, { 237, 201, 175, 255 });
+        if (seaTexture.id == 0) return;
+
+        int sWidth = seaTexture.width; if (sWidth == 0) sWidth = 100;
+        float sHeight = (float)seaTexture.height;
+        float time = (float)GetTime();
+        int from = -2000 + std::max(0, ((int)view.x - sWidth + 2000) / sWidth) * sWidth;
+        for (int i = from; i < (int)world.worldWidth + 2000; i += sWidth) {
+            if (i > view.x + view.width) break;
+            if (i + sWidth < view.x) continue;
+            bool flip = ((i / sWidth) % 2 != 0);
+            float widthFactor = flip ? -1.0f : 1.0f;
+            float waveY = sinf(time * 2.0f + (i * 0.005f)) * 5.0f;
+            Rectangle source = { 0.0f, 0.0f, (float)sWidth * widthFactor, sHeight };
+            Rectangle destBot = { (float)i, 700.0f + waveY, (float)sWidth, 350.0f };
+            DrawTexturePro(seaTexture, source, destBot, {0,0}, 0.0f, WHITE);
+        }
+    }
+
+    void DrawHouses(float left, float right) const {
+        const int end = (int)world.worldWidth + 1000;
+        int firstRepeat = std::max(0, ((int)left - 5000 - HOUSE_MAX_WIDTH) / HOUSE_PERIOD);
+        for (int k = firstRepeat; -1500 + k * HOUSE_PERIOD < std::min((float)end, right); k++) {
+            for (const HousePlacement& h : HOUSES) {
+                int x = h.x + k * HOUSE_PERIOD;
+                if (x + HOUSE_MAX_WIDTH < left || x >= right) continue;
+                if (k > 0 && (x > end || fabsf(x - world.hospitalX) < 500.0f || fabsf(x - world.schoolX) < 600.0f)) continue;
+                DrawTexture(houseTextures[h.texture], x, h.y, WHITE);
             }
         }
 
-        lightTop.Draw();
-        lightBottom.Draw();
-        
-        DrawTexture(hospitalTexture, 10, ROAD_Y_BOTTOM + ROAD_HEIGHT + 10, WHITE);
+        DrawTexture(schoolTexture , (int)world.schoolX - 230, 430, WHITE);
+    }
+
+    void DrawWorld(const WorldFrame& frame) const {
+        PROFILE_SCOPE("draw.world");
+        Rectangle view = VisibleRect();
+
+        // The baked band ends at the top of the beach, so neither covers the other
+        DrawSea(view);
+        {
+            PROFILE_SCOPE("draw.scenery");
+            scenery.Draw(view);
+        }
+
+        for (const FrameLight& light : frame.lights) DrawTrafficLight(light.x, light.y, light.red);
+
+        float bounce = DrawLandmarkArrows();
 
-        // --- ARROWS & LABELS ---
+        // 3. ACCIDENT ARROWS (Flashing, one per accident not yet towed)
+        // A pending one follows the car before the crash happens
+        for (const FrameIncident& acc : frame.incidents) {
+            if (acc.state == INCIDENT_CLEARING || acc.x == 0) continue;
+            DrawAccidentArrow(acc.x, acc.y, bounce);
+        }
+        // -----------------------
+
+        DrawVehicles(frame, view);
+    }
+
+    // --- ARROWS & LABELS ---
+    // Hospital and school markers; returns the bounce offset so the accident
+    // arrows move in step with them
+    float DrawLandmarkArrows() const {
         float time = (float)GetTime();
         float bounce = sinf(time * 6.0f) * 8.0f; 
 
         // 1. HOSPITAL ARROW (Red)
-        float hospCenterX = 75.0f; 
+        float hospCenterX = world.hospitalX - 5.0f; 
         float hospBaseY = 350.0f + bounce;
         Color arrowCol = Fade(RED, 0.8f); 
         DrawRectangle(hospCenterX - 10, hospBaseY, 20, 40, arrowCol);
@@ -512,124 +791,123 @@ public:
         DrawText("HOSPITAL", hospCenterX - 40, hospBaseY - 30, 20, RED);
 
         // 2. SCHOOL ARROW (Orange)
-        float schoolCenterX = WORLD_WIDTH / 2 - 65.0f;
+        float schoolCenterX = world.schoolX - 165.0f;
         float schoolBaseY = 350.0f + bounce; 
         Color schoolArrowCol = Fade(ORANGE, 0.8f);
         DrawRectangle(schoolCenterX - 10, schoolBaseY, 20, 40, schoolArrowCol);
         DrawTriangle({ schoolCenterX, schoolBaseY + 70 }, { schoolCenterX + 25, schoolBaseY + 40 }, { schoolCenterX - 25, schoolBaseY + 40 }, schoolArrowCol);
         DrawText("SCHOOL", schoolCenterX - 35, schoolBaseY - 30, 20, ORANGE);
+        return bounce;
+    }
 
-        // 3. ACCIDENT ARROW (NEW - Flashing)
-        if (currentAccident.active || currentAccident.pending) {
-            float accX = 0;
-            float accY = 0;
-
-            if (currentAccident.active) {
-                accX = currentAccident.x;
-                accY = currentAccident.y;
-            } else if (currentAccident.pending && currentAccident.car1) {
-                // Follow the car before the crash happens
-                accX = currentAccident.car1->GetX();
-                accY = currentAccident.car1->GetY();
-            }
-
-            if (accX != 0) {
-                float arrowBaseY = accY - 80.0f + bounce; // Floating above the car
-                Color flashCol = (int)(GetTime() * 10) % 2 == 0 ? RED : MAROON; 
-
-                DrawRectangle(accX - 10, arrowBaseY - 40, 20, 40, flashCol);
-                DrawTriangle(
-                    { accX, arrowBaseY + 30 },        // Tip Pointing Down
-                    { accX + 25, arrowBaseY },        // Right
-                    { accX - 25, arrowBaseY },        // Left
-                    flashCol
-                );
-                
-                DrawText("ACCIDENT!", accX - 50, arrowBaseY - 65, 20, RED);
-            }
-        }
-        // -----------------------
+    void DrawAccidentArrow(float accX, float accY, float bounce) const {
+        float arrowBaseY = accY - 80.0f + bounce; // Floating above the car
+        Color flashCol = (int)(GetTime() * 10) % 2 == 0 ? RED : MAROON; 
+
+        DrawRectangle(accX - 10, arrowBaseY - 40, 20, 40, flashCol);
+        DrawTriangle(
+            { accX, arrowBaseY + 30 },        // Tip Pointing Down
+            { accX + 25, arrowBaseY },        // Right
+            { accX - 25, arrowBaseY },        // Left
+            flashCol
+        );
         
-        // BOTTOM HOUSES
-        DrawTexture(houseTextures[1], -1500, 440, WHITE);
-        DrawTexture(houseTextures[2], -1250, 423, WHITE);
-        DrawTexture(houseTextures[1], -1020, 440, WHITE);
-        DrawTexture(houseTextures[0], -850, 410, WHITE);
-        DrawTexture(houseTextures[0], -600, 410, WHITE);
-        DrawTexture(houseTextures[1], -250, 440, WHITE);
-        DrawTexture(houseTextures[0], 250, 410, WHITE);
-        DrawTexture(houseTextures[1], 600, 440, WHITE);
-        DrawTexture(houseTextures[2], 850, 423, WHITE);
-        DrawTexture(houseTextures[1], 1100, 440, WHITE);
-        DrawTexture(houseTextures[0], 1400, 410, WHITE);
-        DrawTexture(houseTextures[1], 2400, 440, WHITE);
-        DrawTexture(houseTextures[0], 2600, 410, WHITE);
-        DrawTexture(houseTextures[1], 2900, 440, WHITE);
-        DrawTexture(houseTextures[0], 3200, 410, WHITE);
-        DrawTexture(houseTextures[2], 3550, 423, WHITE);
-        DrawTexture(houseTextures[2], 3850, 423, WHITE);
-        DrawTexture(houseTextures[2], 4100, 423, WHITE);
-        DrawTexture(houseTextures[0], 4300, 410, WHITE);
-        DrawTexture(houseTextures[1], 4700, 440, WHITE);
-        DrawTexture(houseTextures[2], 5000, 423, WHITE);
-        
-        // TOP HOUSES
-        DrawTexture(houseTextures[1], -1500, -125, WHITE);
-        DrawTexture(houseTextures[2], -1250, -125, WHITE);
-        DrawTexture(houseTextures[1], -1020, -125, WHITE);
-        DrawTexture(houseTextures[0], -850, -145, WHITE);
-        DrawTexture(houseTextures[0], -600, -145, WHITE);
-        DrawTexture(houseTextures[1], -250, -125, WHITE);
-        DrawTexture(houseTextures[1], 0, -125, WHITE);
-        DrawTexture(houseTextures[0], 250,-145, WHITE);
-        DrawTexture(houseTextures[1], 600, -118, WHITE);
-        DrawTexture(houseTextures[2], 850, -125, WHITE);
-        DrawTexture(houseTextures[1], 1100, -118, WHITE);
-        DrawTexture(houseTextures[0], 1400, -145, WHITE);
-        DrawTexture(houseTextures[1], 2050, -118, WHITE);
-        DrawTexture(houseTextures[1], 2400, -118, WHITE);
-        DrawTexture(houseTextures[0], 2600, -145, WHITE);
-        DrawTexture(houseTextures[1], 2950, -118, WHITE);
-        DrawTexture(houseTextures[0], 3200, -145, WHITE);
-        DrawTexture(houseTextures[2], 3550, -125, WHITE);
-        DrawTexture(houseTextures[2], 3850, -125, WHITE);
-        DrawTexture(houseTextures[2], 4100, -125, WHITE);
-        DrawTexture(houseTextures[0], 4300, -145, WHITE);
-        DrawTexture(houseTextures[1], 4700, -118, WHITE);
-        DrawTexture(houseTextures[2], 5000, -125, WHITE);
-
-        DrawTexture(schoolTexture , WORLD_WIDTH / 2 - 130, 430, WHITE);
-        
-        for (auto& v : vehiclesTop) v->Draw();
-        for (auto& v : vehiclesBottom) v->Draw();
+        DrawText("ACCIDENT!", accX - 50, arrowBaseY - 65, 20, RED);
     }
 
-    void DrawUI() const {
+    void DrawUI(const WorldFrame& frame) const {
+        PROFILE_SCOPE("draw.ui");
+        size_t active = frame.CountIn(INCIDENT_ACTIVE), pending = frame.CountIn(INCIDENT_PENDING);
         if (screenAlertOn) {
             DrawRectangle(0, 0, 20, SCREEN_HEIGHT, Fade(RED, 0.7f));
             DrawRectangle(SCREEN_WIDTH - 20, 0, 20, SCREEN_HEIGHT, Fade(RED, 0.7f));
         }
         
-        if(currentAccident.active) DrawText("ACCIDENT ACTIVE!", SCREEN_WIDTH/2 - 100, 50, 20, RED);
-        if(currentAccident.pending) DrawText("IMPACT IMMINENT...", SCREEN_WIDTH/2 - 110, 50, 20, ORANGE);
-        if(waitingForTowToLeave && !currentAccident.active && !currentAccident.pending) 
+        if(active == 1) DrawText("ACCIDENT ACTIVE!", SCREEN_WIDTH/2 - 100, 50, 20, RED);
+        if(active > 1) DrawText(TextFormat("%d ACCIDENTS ACTIVE!", (int)active), SCREEN_WIDTH/2 - 120, 50, 20, RED);
+        if(pending) DrawText("IMPACT IMMINENT...", SCREEN_WIDTH/2 - 110, active ? 75 : 50, 20, ORANGE);
+        if(!frame.incidents.empty() && !active && !pending) 
              DrawText("CLEANING UP...", SCREEN_WIDTH/2 - 80, 50, 20, GOLD);
 
         DrawText("Use MOUSE WHEEL to Zoom", 20, 20, 20, WHITE);
         DrawText("Use ARROW KEYS to Pan", 20, 45, 20, WHITE);
+        if (paused) DrawText("PAUSED (P)", 20, 70, 20, GOLD);
+        else if (timeScale != 1.0f) DrawText(TextFormat("SPEED x%.2g (- / =)", timeScale), 20, 70, 20, GOLD);
     }
 
-    void Draw() {
+#ifdef TRAFFIC_PROFILE
+    void ToggleProfiler() { showProfiler = !showProfiler; }
+
+    // Rolling per-phase timings, top right, opposite the help text
+    void DrawProfiler() const {
+        if (!showProfiler) return;
+        const Profiler& prof = Profiler::Get();
+        int x = SCREEN_WIDTH - 380, y = 20, rowHeight = 18;
+        DrawRectangle(x - 10, y - 10, 370, 30 + rowHeight * prof.PhaseCount(), Fade(BLACK, 0.7f));
+        DrawText("PHASE               p50 us    p99 us", x, y, 16, GOLD);
+        for (int i = 0; i < prof.PhaseCount(); i++) {
+            Profiler::Summary sum = prof.Summarize(i);
+            y += rowHeight;
+            DrawText(TextFormat("%-18s %8.1f  %8.1f", sum.name, sum.p50Us, sum.p99Us), x, y, 16, WHITE);
+        }
+    }
+#endif
+
+    // The latest frame from the simulation thread, with vehicles placed
+    // between its last two ticks by the time since it was published
+    void Draw(const WorldFrame& frame) {
+        PROFILE_SCOPE("draw.frame");
+        alpha = frame.Alpha(std::chrono::steady_clock::now());
         BeginMode2D(camera);
-            DrawWorld();
+            DrawWorld(frame);
         EndMode2D();
         
-        DrawUI();
+        DrawUI(frame);
+#ifdef TRAFFIC_PROFILE
+        DrawProfiler();
+#endif
+    }
+
+    // --- PLAYBACK ---
+    // A recorded frame in place of the live model. Lights and incidents are
+    // rebuilt from the frame's chunk, vehicles are drawn as recorded.
+    Rectangle TimelineRect() const { return { 20.0f, SCREEN_HEIGHT - 40.0f, SCREEN_WIDTH - 40.0f, 14.0f }; }
+
+    void DrawPlayback(const TrajectoryFile& file, size_t frame, bool paused) {
+        PROFILE_SCOPE("draw.frame");
+        file.StateAt(frame, playbackLights, playbackIncidents);
+        TrajectoryFile::Frame f = file.FrameAt(frame);
+
+        BeginMode2D(camera);
+            Rectangle view = VisibleRect();
+            DrawSea(view);
+            scenery.Draw(view);
+            for (uint32_t k = 0; k < file.Header().lightCount; k++) DrawTrafficLight(file.Light(k).x, file.Light(k).y, playbackLights[k] != 0);
+            float bounce = DrawLandmarkArrows();
+            for (const TrajectoryIncident& acc : playbackIncidents) {
+                if (acc.state == INCIDENT_ACTIVE) DrawAccidentArrow(acc.x, acc.y, bounce);
+            }
+            DrawRecordedVehicles(f, view);
+        EndMode2D();
+
+        Rectangle bar = TimelineRect();
+        float done = file.FrameCount() > 1 ? (float)frame / (float)(file.FrameCount() - 1) : 1.0f;
+        DrawRectangleRec(bar, Fade(BLACK, 0.6f));
+        DrawRectangle((int)bar.x, (int)bar.y, (int)(bar.width * done), (int)bar.height, GOLD);
+        DrawRectangleLinesEx(bar, 2, WHITE);
+        int seconds = (int)(f.tick / TICKS_PER_SECOND), total = (int)(file.FrameAt(file.FrameCount() - 1).tick / TICKS_PER_SECOND);
+        DrawText(TextFormat("PLAYBACK %02d:%02d / %02d:%02d%s", seconds / 60, seconds % 60, total / 60, total % 60, paused ? "  (PAUSED)" : ""),
+                 (int)bar.x, (int)bar.y - 28, 20, WHITE);
+        DrawText("SPACE pause, [ ] skip 10 s, click the bar to seek", (int)bar.x + 420, (int)bar.y - 28, 20, LIGHTGRAY);
+        DrawText("Use MOUSE WHEEL to Zoom", 20, 20, 20, WHITE);
+        DrawText("Use ARROW KEYS to Pan", 20, 45, 20, WHITE);
     }
 
+    // The start button stays disabled until ContinueLoading() is done
     bool DrawIntroScreen() {
         BeginMode2D(camera);
-        road.Draw();
+        Rectangle view = VisibleRect();
+        road.Draw(world, view.x, view.x + view.width);
         EndMode2D();
 
         DrawRectangle(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, Fade(BLACK, 0.85f));
@@ -647,11 +925,21 @@ public:
         DrawText("- Press 'S' to send the School Bus.", boxX + 40, boxY + 190, 20, WHITE);
         DrawText("- SCROLL MOUSE to Zoom. RIGHT CLICK/ARROWS to Pan.", boxX + 40, boxY + 230, 20, YELLOW);
         DrawText("- The Bus will stop at the School (Middle of map).", boxX + 40, boxY + 260, 20, WHITE);
+        DrawText("- 'P' to pause, '-' / '=' to slow down or speed up.", boxX + 40, boxY + 290, 20, WHITE);
         
         Rectangle btnBounds = { (float)SCREEN_WIDTH/2 - 100, (float)SCREEN_HEIGHT - 100, 200, 60 };
         Vector2 mousePoint = GetMousePosition();
         bool btnHover = CheckCollisionPointRec(mousePoint, btnBounds);
         
+        if (!loaded) {
+            float done = (float)assets.CollectedCount() / (float)assets.Count();
+            DrawRectangleRec(btnBounds, DARKGRAY);
+            DrawRectangle((int)btnBounds.x, (int)btnBounds.y, (int)(btnBounds.width * done), (int)btnBounds.height, DARKGREEN);
+            DrawRectangleLinesEx(btnBounds, 3, LIGHTGRAY);
+            DrawText(TextFormat("LOADING %d/%d", (int)assets.CollectedCount(), (int)assets.Count()), (int)btnBounds.x + 25, (int)btnBounds.y + 15, 24, LIGHTGRAY);
+            return false;
+        }
+
         DrawRectangleRec(btnBounds, btnHover ? GREEN : DARKGREEN);
         DrawRectangleLinesEx(btnBounds, 3, WHITE);
         DrawText("START GAME", (int)btnBounds.x + 25, (int)btnBounds.y + 15, 24, WHITE);
@@ -663,56 +951,160 @@ public:
         return false;
     }
 
-    ~Simulation() {
+    ~Viewer() {
         UnloadSound(siren);
-        UnloadTexture(hospitalTexture);
-        UnloadTexture(schoolTexture);
-        for(int i=0; i<3; i++) UnloadTexture(houseTextures[i]);
-        UnloadTexture(jungleTexture);
-        UnloadTexture(seaTexture);
+        TraceLog(LOG_INFO, "SCENERY: %d tile bakes and %d evictions over the run, %d resident, %zu bytes", scenery.BakeCount(), scenery.EvictionCount(),
+                 scenery.ResidentCount(), scenery.BytesResident());
+        TraceLog(LOG_INFO, "TEXTURES: %d loads over the run, %d resident, %zu bytes", textures.LoadCount(), textures.ResidentCount(), textures.BytesResident());
     }
 };
 
-int main() {
+int main(int argc, char** argv) {
+    uint64_t seed = (uint64_t)time(nullptr);
+    const char* recordPath = nullptr;
+    const char* replayPath = nullptr;
+    const char* configPath = nullptr;
+    const char* trajectoryPath = nullptr;
+    const char* playPath = nullptr;
+    const char* assetsPath = "assets.pak";
+    bool lod = false;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--seed") == 0 && hasValue) seed = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--record") == 0 && hasValue) recordPath = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && hasValue) replayPath = argv[++i];
+        else if (strcmp(argv[i], "--config") == 0 && hasValue) configPath = argv[++i];
+        else if (strcmp(argv[i], "--trajectory") == 0 && hasValue) trajectoryPath = argv[++i];
+        else if (strcmp(argv[i], "--play") == 0 && hasValue) playPath = argv[++i];
+        else if (strcmp(argv[i], "--lod") == 0) lod = true;
+        else if (strcmp(argv[i], "--assets") == 0 && hasValue) assetsPath = argv[++i];
+    }
+
+    WorldConfig world;
+    std::string configError;
+    if (configPath && !LoadWorldConfig(configPath, world, configError)) { std::cerr << configError << std::endl; return 1; }
+    // The camera only pans sideways, so every road has to fit the window's height
+    for (size_t k = 0; k < world.roads.size(); k++) {
+        const RoadConfig& r = world.roads[k];
+        if (r.y < 20 || r.y + world.RoadHeight(r) + 20 > SCREEN_HEIGHT) {
+            std::cerr << "roads[" << k << "] lies outside the visible band 20.." << SCREEN_HEIGHT - 20 << std::endl;
+            return 1;
+        }
+    }
+
+    // The focus follows the camera, which a command log does not record, and
+    // a trajectory only sees the cars simulated in detail
+    if (lod && (recordPath || replayPath || trajectoryPath)) { std::cerr << "--lod cannot be combined with --record, --replay or --trajectory" << std::endl; return 1; }
+
+    CommandLog log;
+    if (replayPath) {
+        if (!log.Load(replayPath)) { std::cerr << "Cannot read replay " << replayPath << std::endl; return 1; }
+        seed = log.GetSeed();
+    }
+    log.SetSeed(seed);
+
+    // --play shows a trajectory recording instead of running the model
+    TrajectoryFile playback;
+    if (playPath) {
+        std::string playError;
+        if (!playback.Open(playPath, playError)) { std::cerr << playError << std::endl; return 1; }
+        if (playback.FrameCount() == 0) { std::cerr << playPath << ": no complete frames" << std::endl; return 1; }
+        if (playback.Header().roadCount != world.roads.size()) std::cerr << playPath << ": recorded with another road layout, pass the same --config" << std::endl;
+    }
+    size_t playFrame = 0;
+    bool playPaused = false;
+
     InitAudioDevice();
     InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Emergency & Priority Management");
     SetTargetFPS(60);
     
     {
-        Simulation sim;
-        sim.Init();
+        Simulation sim(world);
+        Viewer viewer;
+        sim.Init(seed);
+        if (recordPath) sim.SetRecorder(&log);
+        sim.SetLevelOfDetail(lod);
+        TrajectoryRecorder trajectory;
+        if (trajectoryPath && !trajectory.Open(trajectoryPath, sim, seed)) TraceLog(LOG_WARNING, "TRAJECTORY: cannot write %s", trajectoryPath);
+        // From the start button on, the model runs on its own thread
+        SimulationThread simThread(sim);
+        if (replayPath) simThread.SetReplay(&log);
+        simThread.SetTrajectory(&trajectory);
+        viewer.Init(world, assetsPath);
         bool gameStarted = false; 
+        float accumulator = 0.0f;
 
         while (!WindowShouldClose()) {
             float delta = GetFrameTime();
+            if (!gameStarted) viewer.ContinueLoading();
 
             if (gameStarted) {
-                sim.Update(delta);
+                PROFILE_SCOPE("frame.update");
+                viewer.HandleCameraInput();
+#ifdef TRAFFIC_PROFILE
+                if (IsKeyPressed(KEY_F3)) viewer.ToggleProfiler();
+#endif
+
+                if (playPath) {
+                    size_t last = playback.FrameCount() - 1;
+                    if (IsKeyPressed(KEY_SPACE)) playPaused = !playPaused;
+                    if (IsKeyPressed(KEY_RIGHT_BRACKET)) playFrame = std::min(last, playFrame + 10 * TICKS_PER_SECOND);
+                    if (IsKeyPressed(KEY_LEFT_BRACKET)) playFrame = playFrame > 10 * TICKS_PER_SECOND ? playFrame - 10 * TICKS_PER_SECOND : 0;
+                    Rectangle bar = viewer.TimelineRect();
+                    Vector2 mouse = GetMousePosition();
+                    if (IsMouseButtonDown(MOUSE_BUTTON_LEFT) && CheckCollisionPointRec(mouse, bar)) {
+                        playFrame = (size_t)((mouse.x - bar.x) / bar.width * (float)last);
+                    }
+                    accumulator += delta;
+                    for (int steps = 0; accumulator >= TICK_DT && steps < MAX_TICKS_PER_FRAME; steps++) {
+                        if (!playPaused && playFrame < last) playFrame++;
+                        accumulator -= TICK_DT;
+                    }
+                    if (accumulator >= TICK_DT) accumulator = 0.0f;
+                } else {
+                    if (!replayPath) {
+                        if (IsKeyPressed(KEY_E)) { simThread.Submit(CMD_CALL_AMBULANCE); viewer.PlaySiren(); }
+                        if (IsKeyPressed(KEY_D)) simThread.Submit(CMD_CALL_DEPANNAGE);
+                        if (IsKeyPressed(KEY_A)) simThread.Submit(CMD_TRIGGER_ACCIDENT);
+                        if (IsKeyPressed(KEY_S)) simThread.Submit(CMD_CALL_SCHOOL_BUS);
+                    }
+
+                    viewer.HandleClockInput();
+                    simThread.SetClock(viewer.IsPaused(), viewer.TimeScale());
+                    if (lod) { Rectangle view = viewer.VisibleRect(); simThread.SetFocus(view.x, view.x + view.width); }
+                    viewer.UpdateAlert(simThread.Latest(), delta);
+                }
             }
 
+            if (gameStarted) viewer.StreamScenery();
+
             BeginDrawing();
             ClearBackground(SKYBLUE);
 
             if (!gameStarted) {
-                if (sim.DrawIntroScreen()) {
+                if (viewer.DrawIntroScreen()) {
                     gameStarted = true;
+                    if (!playPath) simThread.Start();
                 }
+            } else if (playPath) {
+                viewer.DrawPlayback(playback, playFrame, playPaused);
             } else {
-                sim.Draw();
+                viewer.Draw(simThread.Latest());
             }
 
             EndDrawing();
-
-            if (gameStarted) {
-                if (IsKeyPressed(KEY_E)) sim.CallAmbulance();
-                if (IsKeyPressed(KEY_D)) sim.CallDepannage();
-                if (IsKeyPressed(KEY_A)) sim.TriggerRandomAccident();
-                if (IsKeyPressed(KEY_S)) sim.CallSchoolBus(); 
-            }
         }
+
+        simThread.Stop();
+        if (!trajectory.Close()) TraceLog(LOG_WARNING, "TRAJECTORY: write to %s failed", trajectoryPath);
+        if (recordPath && !log.Save(recordPath)) std::cerr << "Cannot write recording " << recordPath << std::endl;
+        TraceLog(LOG_INFO, "SIM: seed %llu, %u ticks, state hash %016llx", (unsigned long long)seed, sim.GetTick(), (unsigned long long)sim.StateHash());
+#ifdef TRAFFIC_PROFILE
+        if (Profiler::Get().WriteCsv("profile.csv")) TraceLog(LOG_INFO, "PROFILE: phase timings written to profile.csv");
+#endif
     } 
 
     CloseAudioDevice();
     CloseWindow();
     return 0;
-}
\ No newline at end of file
+}
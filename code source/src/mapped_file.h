@@ -0,0 +1,77 @@
+#pragma once
+// Read-only view of a whole file. Memory-mapped where the OS allows it, so
+// opening costs nothing up front and pages come in as they are touched;
+// on Windows the file is read into memory instead.
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+class MappedFile {
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    std::vector<uint8_t> contents;
+#else
+    void* mapping = nullptr;
+#endif
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { Close(); }
+
+    // False if the file cannot be read; an empty file maps to nothing and
+    // counts as unreadable
+    bool Open(const char* path) {
+        Close();
+#ifdef _WIN32
+        FILE* f = fopen(path, "rb");
+        if (!f) return false;
+        uint8_t buf[65536];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0) contents.insert(contents.end(), buf, buf + n);
+        bool ok = ferror(f) == 0 && !contents.empty();
+        fclose(f);
+        data = contents.data();
+        size = contents.size();
+        return ok;
+#else
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) { close(fd); return false; }
+        size = (size_t)st.st_size;
+        if (size > 0) {
+            mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) mapping = nullptr;
+        }
+        close(fd);
+        data = (const uint8_t*)mapping;
+        return mapping != nullptr;
+#endif
+    }
+
+    void Close() {
+#ifdef _WIN32
+        contents.clear();
+#else
+        if (mapping) munmap(mapping, size);
+        mapping = nullptr;
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    bool IsOpen() const { return data != nullptr; }
+    const uint8_t* Data() const { return data; }
+    size_t Size() const { return size; }
+};
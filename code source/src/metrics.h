@@ -0,0 +1,154 @@
+#pragma once
+// Emergency-response measurements collected over many runs. Histograms use
+// fixed log-linear buckets, so two of them merge by adding counts: each
+// worker of the Monte Carlo runner fills its own and the totals come out
+// the same whatever order the runs finished in. Saved histograms from
+// separate machines merge the same way.
+//
+// Buckets are exact below 32 and 1/16 of a power of two wide above, so a
+// percentile is within about 6% of the true value.
+//
+// Metrics file layout (little endian):
+//   "TRMC" | u32 version | u64 payload size | payload | u64 payload hash
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "snapshot.h"
+
+constexpr uint32_t METRICS_VERSION = 2;
+
+class Histogram {
+private:
+    static constexpr int SUB_BITS = 4;
+    static constexpr uint32_t SUB = 1u << SUB_BITS;
+    static constexpr uint32_t BUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+    std::vector<uint64_t> counts;
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t low = UINT64_MAX, high = 0;
+
+    static uint32_t Bucket(uint64_t v) {
+        if (v < 2 * SUB) return (uint32_t)v;
+        int shift = 63 - __builtin_clzll(v) - SUB_BITS;
+        return (uint32_t)((shift + 1) * SUB + ((v >> shift) - SUB));
+    }
+    // Largest value that falls in bucket b
+    static uint64_t BucketTop(uint32_t b) {
+        if (b < 2 * SUB) return b;
+        int shift = (int)(b / SUB) - 1;
+        return (((uint64_t)(SUB + b % SUB) + 1) << shift) - 1;
+    }
+
+public:
+    Histogram() : counts(BUCKETS, 0) {}
+
+    void Add(uint64_t v) {
+        counts[Bucket(v)]++;
+        total++;
+        sum += v;
+        low = std::min(low, v);
+        high = std::max(high, v);
+    }
+
+    void Merge(const Histogram& o) {
+        for (uint32_t b = 0; b < BUCKETS; b++) counts[b] += o.counts[b];
+        total += o.total;
+        sum += o.sum;
+        low = std::min(low, o.low);
+        high = std::max(high, o.high);
+    }
+
+    uint64_t Count() const { return total; }
+    uint64_t Min() const { return total ? low : 0; }
+    uint64_t Max() const { return high; }
+    double Mean() const { return total ? (double)sum / (double)total : 0.0; }
+
+    // Smallest bucket bound at or above the q-quantile (q in [0, 1]),
+    // clamped to the largest value seen
+    uint64_t Percentile(double q) const {
+        if (total == 0) return 0;
+        uint64_t rank = (uint64_t)(q * (double)total + 0.5);
+        rank = std::max<uint64_t>(1, std::min(rank, total));
+        uint64_t seen = 0;
+        for (uint32_t b = 0; b < BUCKETS; b++) {
+            seen += counts[b];
+            if (seen >= rank) return std::max(low, std::min(high, BucketTop(b)));
+        }
+        return high;
+    }
+
+    template <class A> void Transfer(A& ar) {
+        ar.Array(counts, BUCKETS);
+        ar.Value(total); ar.Value(sum); ar.Value(low); ar.Value(high);
+        ar.Check(counts.size() == BUCKETS, "metrics histogram has the wrong bucket count");
+    }
+};
+
+// Everything the runner reports. Times are in ticks from the crash.
+// Per-run figures only add up across runs of the same length, so only
+// metrics with the same ticksPerRun (or no runs yet) merge.
+struct ResponseMetrics {
+    Histogram response;      // until the ambulance stops at the scene
+    Histogram hospital;      // until it reaches the hospital (WAIT_AT_HOSPITAL)
+    Histogram clearance;     // until the tow truck has dragged the wrecks off the map
+    Histogram yields;        // lane changes made to let an emergency vehicle by, per run
+    Histogram queue;         // vehicles waiting at a stop line, one sample per light per second
+    uint64_t runs = 0;
+    uint64_t ticksPerRun = 0;
+
+    bool CanMerge(const ResponseMetrics& o) const { return runs == 0 || o.runs == 0 || ticksPerRun == o.ticksPerRun; }
+
+    void Merge(const ResponseMetrics& o) {
+        if (runs == 0) ticksPerRun = o.ticksPerRun;
+        response.Merge(o.response); hospital.Merge(o.hospital); clearance.Merge(o.clearance);
+        yields.Merge(o.yields); queue.Merge(o.queue);
+        runs += o.runs;
+    }
+
+    template <class A> void Transfer(A& ar) {
+        response.Transfer(ar); hospital.Transfer(ar); clearance.Transfer(ar);
+        yields.Transfer(ar); queue.Transfer(ar);
+        ar.Value(runs); ar.Value(ticksPerRun);
+    }
+
+    // Not const, like Simulation::SaveSnapshot(): Transfer serves both ways
+    bool Save(const char* path) {
+        std::vector<uint8_t> payload, out;
+        SnapshotWriter w(payload);
+        Transfer(w);
+        const char magic[4] = { 'T', 'R', 'M', 'C' };
+        SnapshotWriter frame(out);
+        frame.Value(magic);
+        frame.Value(METRICS_VERSION);
+        frame.Value((uint64_t)payload.size());
+        out.insert(out.end(), payload.begin(), payload.end());
+        frame.Value(SnapshotHash(payload.data(), payload.size()));
+        return WriteSnapshotFile(path, out);
+    }
+
+    // Replaces the contents with a saved file; merge it in separately
+    bool Load(const char* path, std::string& error) {
+        std::vector<uint8_t> data;
+        if (!ReadSnapshotFile(path, data)) { error = std::string(path) + ": cannot read the file"; return false; }
+        SnapshotReader r(data.data(), data.size());
+        char magic[4] = { 0 };
+        uint32_t version = 0;
+        uint64_t size = 0;
+        r.Value(magic); r.Value(version); r.Value(size);
+        const size_t header = 4 + 4 + 8;
+        if (!r.Ok() || memcmp(magic, "TRMC", 4) != 0) { error = std::string(path) + ": not a metrics file"; return false; }
+        if (version != METRICS_VERSION) { error = std::string(path) + ": unsupported metrics version"; return false; }
+        if (size + 8 != data.size() - header) { error = std::string(path) + ": truncated"; return false; }
+        uint64_t hash;
+        memcpy(&hash, data.data() + header + size, sizeof(hash));
+        if (hash != SnapshotHash(data.data() + header, (size_t)size)) { error = std::string(path) + ": damaged"; return false; }
+        SnapshotReader payload(data.data() + header, (size_t)size);
+        Transfer(payload);
+        payload.Check(payload.AtEnd(), "trailing data");
+        if (!payload.Ok()) { error = std::string(path) + ": " + payload.Error(); return false; }
+        return true;
+    }
+};
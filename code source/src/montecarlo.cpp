@@ -0,0 +1,190 @@
+// Monte Carlo scenario runner: many independently seeded headless runs
+// spread over every core, each with its own draw of spawn rate, light
+// cycles and accident frequency, all feeding one set of emergency-response
+// histograms (src/metrics.h).
+//
+//   montecarlo [--runs N] [--ticks N] [--seed N] [--threads N] [--config FILE]
+//              [--spawn MIN:MAX] [--cycle MIN:MAX] [--accidents MIN:MAX]
+//              [--save FILE] [--merge FILE]... [--quiet]
+//
+// Run k is seeded with seed + k and draws its parameters from its own
+// generator, so its result does not depend on --threads or on which
+// runs went before it. Each run has the operator dispatch every crash.
+// --spawn scales the config's spawn delays (2 = half the traffic),
+// --cycle sets every light's cycle time in seconds and --accidents the
+// per-tick chance of a random accident in thousandths; each is drawn
+// uniformly from its range per run, or left as configured if not given.
+//
+// Every finished run prints one JSON line; the last line sums up all of
+// them with count, mean and p50/p95/p99/max per histogram. Times are in
+// seconds from the crash. --save writes the histograms to a file that a
+// later --merge adds back in, so batches run on several machines (or
+// --runs 0 over saved files) report as one. The file records the ticks
+// per run, and batches of different lengths refuse to merge.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include "simulation.h"
+#include "metrics.h"
+#include "operator.h"
+
+struct Range {
+    float low, high;
+    bool given;
+};
+
+struct RunnerConfig {
+    int runs = 100;
+    long long ticks = 60LL * 60 * 10;
+    uint64_t seed = 1;
+    bool quiet = false;
+    Range spawn = { 1.0f, 1.0f, false };
+    Range cycle = { 0.0f, 0.0f, false };
+    Range accidents = { 0.0f, 0.0f, false };
+    WorldConfig world;
+};
+
+// Uniform in [low, high] in thousandths of the range
+static float Draw(Rng& rng, const Range& r) {
+    return r.low + (r.high - r.low) * (float)rng.Int(0, 1000) / 1000.0f;
+}
+
+static bool ParseRange(const char* text, Range& r) {
+    r.given = sscanf(text, "%f:%f", &r.low, &r.high) == 2 && r.low >= 0.0f && r.low <= r.high;
+    return r.given;
+}
+
+static void PrintHistogram(const char* name, const Histogram& h, double scale) {
+    printf("\"%s\":{\"count\":%llu,\"mean\":%.2f,\"p50\":%.2f,\"p95\":%.2f,\"p99\":%.2f,\"max\":%.2f}",
+           name, (unsigned long long)h.Count(), h.Mean() * scale, h.Percentile(0.50) * scale,
+           h.Percentile(0.95) * scale, h.Percentile(0.99) * scale, h.Max() * scale);
+}
+
+// One run; its histograms go into `out`, which starts empty
+static void RunScenario(const RunnerConfig& cfg, int k, ResponseMetrics& out, std::mutex& printMutex) {
+    Rng draw;
+    draw.Seed(cfg.seed + (uint64_t)k, 1013u);
+    WorldConfig world = cfg.world;
+    float spawnScale = cfg.spawn.given ? Draw(draw, cfg.spawn) : 1.0f;
+    world.spawnMinDelay = std::max(0.1f, world.spawnMinDelay * spawnScale);
+    world.spawnMaxDelay = std::max(world.spawnMinDelay, world.spawnMaxDelay * spawnScale);
+    float cycleSum = 0.0f;
+    int lights = 0;
+    for (RoadConfig& road : world.roads) {
+        for (SignalConfig& signal : road.signals) {
+            if (cfg.cycle.given) signal.cycleTime = std::max(0.1f, Draw(draw, cfg.cycle));
+            cycleSum += signal.cycleTime;
+            lights++;
+        }
+    }
+    if (cfg.accidents.given) world.accidentPerMille = (int)std::lround(Draw(draw, cfg.accidents));
+
+    Simulation sim(world);
+    sim.Init(cfg.seed + (uint64_t)k);
+    sim.SetMetrics(&out);
+    Operator op;
+    size_t queueMax = 0;
+    for (long long t = 0; t < cfg.ticks; t++) {
+        op.Update(sim);
+        sim.Step();
+        if (sim.GetTick() % TICKS_PER_SECOND != 0) continue;
+        for (int r = 0; r < sim.RoadCount(); r++) {
+            for (size_t l = 0; l < sim.GetRoad(r).lights.size(); l++) {
+                size_t q = sim.QueueAt(r, (int)l);
+                out.queue.Add(q);
+                queueMax = std::max(queueMax, q);
+            }
+        }
+    }
+    const SimStats& stats = sim.GetStats();
+    out.yields.Add((uint64_t)stats.yields);
+    out.runs = 1;
+    out.ticksPerRun = (uint64_t)cfg.ticks;
+    if (cfg.quiet) return;
+
+    const double seconds = 1.0 / TICKS_PER_SECOND;
+    std::lock_guard<std::mutex> lock(printMutex);
+    printf("{\"run\":%d,\"seed\":%llu,\"spawn_scale\":%.3f,\"mean_cycle_s\":%.2f,\"accident_per_mille\":%d,\"accidents\":%lld,"
+           "\"responses\":%llu,\"response_p50_s\":%.2f,\"hospital_p50_s\":%.2f,\"clearance_p50_s\":%.2f,\"yields\":%lld,\"queue_max\":%zu,\"state_hash\":\"%016llx\"}\n",
+           k, (unsigned long long)(cfg.seed + (uint64_t)k), spawnScale, lights ? cycleSum / lights : 0.0f, world.accidentPerMille, stats.accidents,
+           (unsigned long long)out.response.Count(), out.response.Percentile(0.5) * seconds, out.hospital.Percentile(0.5) * seconds,
+           out.clearance.Percentile(0.5) * seconds, stats.yields, queueMax, (unsigned long long)sim.StateHash());
+    fflush(stdout);
+}
+
+static void PrintUsage() {
+    printf("usage: montecarlo [--runs N] [--ticks N] [--seed N] [--threads N] [--config FILE] [--spawn MIN:MAX] [--cycle MIN:MAX] [--accidents MIN:MAX] [--save FILE] [--merge FILE]... [--quiet]\n");
+}
+
+int main(int argc, char** argv) {
+    RunnerConfig cfg;
+    int threads = 0;
+    const char* configPath = nullptr;
+    const char* savePath = nullptr;
+    std::vector<const char*> mergePaths;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--runs") == 0 && hasValue) cfg.runs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--ticks") == 0 && hasValue) cfg.ticks = atoll(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && hasValue) cfg.seed = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--threads") == 0 && hasValue) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--config") == 0 && hasValue) configPath = argv[++i];
+        else if (strcmp(argv[i], "--spawn") == 0 && hasValue) { if (!ParseRange(argv[++i], cfg.spawn)) { PrintUsage(); return 1; } }
+        else if (strcmp(argv[i], "--cycle") == 0 && hasValue) { if (!ParseRange(argv[++i], cfg.cycle)) { PrintUsage(); return 1; } }
+        else if (strcmp(argv[i], "--accidents") == 0 && hasValue) { if (!ParseRange(argv[++i], cfg.accidents) || cfg.accidents.high > 1000.0f) { PrintUsage(); return 1; } }
+        else if (strcmp(argv[i], "--save") == 0 && hasValue) savePath = argv[++i];
+        else if (strcmp(argv[i], "--merge") == 0 && hasValue) mergePaths.push_back(argv[++i]);
+        else if (strcmp(argv[i], "--quiet") == 0) cfg.quiet = true;
+        else { PrintUsage(); return 1; }
+    }
+    if (cfg.runs < 0 || cfg.ticks <= 0 || threads < 0) { PrintUsage(); return 1; }
+
+    std::string error;
+    if (configPath && !LoadWorldConfig(configPath, cfg.world, error)) { fprintf(stderr, "%s\n", error.c_str()); return 1; }
+
+    ResponseMetrics total;
+    for (const char* path : mergePaths) {
+        ResponseMetrics saved;
+        if (!saved.Load(path, error)) { fprintf(stderr, "%s\n", error.c_str()); return 1; }
+        if (!total.CanMerge(saved)) {
+            fprintf(stderr, "%s: runs of %llu ticks do not merge with runs of %llu\n", path, (unsigned long long)saved.ticksPerRun, (unsigned long long)total.ticksPerRun);
+            return 1;
+        }
+        total.Merge(saved);
+    }
+
+    if (cfg.runs > 0 && total.runs > 0 && total.ticksPerRun != (uint64_t)cfg.ticks) {
+        fprintf(stderr, "--ticks %lld does not match the merged runs of %llu ticks\n", cfg.ticks, (unsigned long long)total.ticksPerRun);
+        return 1;
+    }
+
+    // Each run fills its own histograms and merges them in when done;
+    // merging only adds counts, so the totals do not depend on the order
+    ThreadPool pool((unsigned)threads);
+    std::mutex totalMutex, printMutex;
+    auto start = std::chrono::steady_clock::now();
+    pool.Run((uint32_t)cfg.runs, [&](uint32_t k) {
+        ResponseMetrics run;
+        RunScenario(cfg, (int)k, run, printMutex);
+        std::lock_guard<std::mutex> lock(totalMutex);
+        total.Merge(run);
+    });
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (savePath && !total.Save(savePath)) { fprintf(stderr, "cannot write metrics %s\n", savePath); return 1; }
+
+    const double seconds = 1.0 / TICKS_PER_SECOND;
+    printf("{\"summary\":true,\"runs\":%llu,\"ticks_per_run\":%llu,\"threads\":%zu,\"wall_s\":%.2f,",
+           (unsigned long long)total.runs, (unsigned long long)total.ticksPerRun, pool.Size(), wall);
+    PrintHistogram("response_s", total.response, seconds); printf(",");
+    PrintHistogram("hospital_s", total.hospital, seconds); printf(",");
+    PrintHistogram("clearance_s", total.clearance, seconds); printf(",");
+    PrintHistogram("yields_per_run", total.yields, 1.0); printf(",");
+    PrintHistogram("stop_line_queue", total.queue, 1.0);
+    printf("}\n");
+    return 0;
+}
@@ -0,0 +1,15 @@
+#pragma once
+// Plays the part of the person at the keyboard in unattended runs: sends an
+// ambulance to every crash, then a tow truck once that ambulance has left
+// for the hospital. Commands take effect on the next Step(), before this
+// is consulted again, so the counts it reads are always current.
+
+#include "simulation.h"
+
+class Operator {
+public:
+    void Update(Simulation& sim) {
+        for (int k = sim.AmbulancesNeeded(); k > 0; k--) sim.Submit(CMD_CALL_AMBULANCE);
+        for (int k = sim.TowsReady(); k > 0; k--) sim.Submit(CMD_CALL_DEPANNAGE);
+    }
+};
@@ -0,0 +1,55 @@
+// Asset pack tool: bundles the window's images and sounds into one archive
+// (src/asset_pack.h), or lists and checks an existing one.
+//
+//   pack [--out FILE] FILES...
+//   pack --list FILE
+//
+// --out defaults to assets.pak, which is where the window looks for it.
+// Assets are stored under their file name without the directory.
+// --list prints every entry and checks its contents against the stored
+// hash; it exits with 1 if any of them is damaged.
+
+#include <cstdio>
+#include <cstring>
+#include "asset_pack.h"
+
+static void PrintUsage() {
+    printf("usage: pack [--out FILE] FILES...\n       pack --list FILE\n");
+}
+
+static int List(const char* path) {
+    AssetPack pack;
+    std::string error;
+    if (!pack.Open(path, error)) { fprintf(stderr, "%s\n", error.c_str()); return 1; }
+    for (uint32_t k = 0; k < pack.Count(); k++) {
+        const AssetPackEntry& e = pack.Entry(k);
+        printf("%10llu  %016llx  %s\n", (unsigned long long)e.size, (unsigned long long)e.hash, e.name);
+    }
+    printf("%u assets, %zu bytes\n", pack.Count(), pack.Bytes());
+    const char* damaged = pack.Verify();
+    if (damaged) { fprintf(stderr, "%s: %s is damaged\n", path, damaged); return 1; }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    const char* outPath = "assets.pak";
+    const char* listPath = nullptr;
+    std::vector<const char*> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--out") == 0 && hasValue) outPath = argv[++i];
+        else if (strcmp(argv[i], "--list") == 0 && hasValue) listPath = argv[++i];
+        else if (argv[i][0] == '-') { PrintUsage(); return 1; }
+        else inputs.push_back(argv[i]);
+    }
+    if (listPath) return List(listPath);
+    if (inputs.empty()) { PrintUsage(); return 1; }
+
+    std::string error;
+    if (!WriteAssetPack(outPath, inputs, error)) { fprintf(stderr, "%s\n", error.c_str()); return 1; }
+    AssetPack pack;
+    if (!pack.Open(outPath, error)) { fprintf(stderr, "%s\n", error.c_str()); return 1; }
+    printf("%s: %u assets, %zu bytes\n", outPath, pack.Count(), pack.Bytes());
+    return 0;
+}
@@ -0,0 +1,127 @@
+#pragma once
+// Per-phase timers. PROFILE_SCOPE("name") times the rest of the enclosing
+// block and files the sample under that name; nested scopes are inclusive.
+// Each phase keeps its last WINDOW samples for rolling p50/p99.
+//
+// Only compiled in when TRAFFIC_PROFILE is defined (DEBUG builds). In any
+// other build the macro expands to nothing and this header adds no code.
+// The window times the model on its simulation thread and the frame on
+// the main thread, so every call takes a lock; that is only affordable
+// because none of this is in release builds.
+
+#ifdef TRAFFIC_PROFILE
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+class Profiler {
+public:
+    static constexpr int WINDOW = 240;
+    static constexpr int MAX_PHASES = 48;
+
+    struct Summary { const char* name; long long count; double meanUs, p50Us, p99Us, maxUs; };
+
+private:
+    struct Phase {
+        const char* name;
+        float samples[WINDOW];          // microseconds, ring buffer
+        int next = 0, filled = 0;
+        long long count = 0;
+        double totalUs = 0.0, maxUs = 0.0;
+    };
+    Phase phases[MAX_PHASES];
+    int phaseCount = 0;
+    mutable std::vector<float> scratch;
+    mutable std::mutex mutex;
+
+    Profiler() = default;
+
+public:
+    static Profiler& Get() {
+        static Profiler instance;
+        return instance;
+    }
+
+    // Id for a phase name, registering it on first use. Call sites cache it.
+    int Register(const char* name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int i = 0; i < phaseCount; i++) if (strcmp(phases[i].name, name) == 0) return i;
+        if (phaseCount == MAX_PHASES) return -1;
+        phases[phaseCount].name = name;
+        return phaseCount++;
+    }
+
+    void Record(int id, double us) {
+        if (id < 0) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        Phase& p = phases[id];
+        p.samples[p.next] = (float)us;
+        p.next = (p.next + 1) % WINDOW;
+        if (p.filled < WINDOW) p.filled++;
+        p.count++;
+        p.totalUs += us;
+        if (us > p.maxUs) p.maxUs = us;
+    }
+
+    int PhaseCount() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return phaseCount;
+    }
+
+    // Rolling percentiles over the window; mean and max cover the whole run
+    Summary Summarize(int id) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        const Phase& p = phases[id];
+        Summary s = { p.name, p.count, p.count ? p.totalUs / p.count : 0.0, 0.0, 0.0, p.maxUs };
+        if (p.filled == 0) return s;
+        scratch.assign(p.samples, p.samples + p.filled);
+        size_t mid = scratch.size() / 2, high = (scratch.size() * 99) / 100;
+        std::nth_element(scratch.begin(), scratch.begin() + mid, scratch.end());
+        s.p50Us = scratch[mid];
+        std::nth_element(scratch.begin(), scratch.begin() + high, scratch.end());
+        s.p99Us = scratch[high];
+        return s;
+    }
+
+    bool WriteCsv(const char* path) const {
+        FILE* f = fopen(path, "w");
+        if (!f) return false;
+        fprintf(f, "phase,count,mean_us,p50_us,p99_us,max_us\n");
+        for (int i = 0; i < phaseCount; i++) {
+            Summary s = Summarize(i);
+            fprintf(f, "%s,%lld,%.3f,%.3f,%.3f,%.3f\n", s.name, s.count, s.meanUs, s.p50Us, s.p99Us, s.maxUs);
+        }
+        bool ok = ferror(f) == 0;
+        fclose(f);
+        return ok;
+    }
+};
+
+class ProfileScope {
+private:
+    int id;
+    std::chrono::steady_clock::time_point start;
+public:
+    explicit ProfileScope(int phase) : id(phase), start(std::chrono::steady_clock::now()) {}
+    ~ProfileScope() {
+        Profiler::Get().Record(id, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+#define PROFILE_JOIN2(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN2(a, b)
+#define PROFILE_SCOPE(name) \
+    static const int PROFILE_JOIN(profilePhase_, __LINE__) = Profiler::Get().Register(name); \
+    ProfileScope PROFILE_JOIN(profileScope_, __LINE__)(PROFILE_JOIN(profilePhase_, __LINE__))
+
+#else
+
+#define PROFILE_SCOPE(name) do {} while (0)
+
+#endif
@@ -0,0 +1,43 @@
+#pragma once
+// The simulation's only source of randomness: a small PCG32 generator.
+// All draws go through one stream, so the same seed always produces the
+// same traffic regardless of front end, frame rate or platform libc.
+
+#include <cstdint>
+#include <utility>
+
+class Rng {
+private:
+    uint64_t state = 0x853c49e6748fea9bULL;
+    uint64_t inc = 0xda3e39cb94b95bdbULL;
+public:
+    void Seed(uint64_t seed, uint64_t stream = 54u) {
+        state = 0u;
+        inc = (stream << 1u) | 1u;
+        Next();
+        state += seed;
+        Next();
+    }
+
+    uint32_t Next() {
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + inc;
+        uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+        uint32_t rot = (uint32_t)(old >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((0u - rot) & 31u));
+    }
+
+    // Uniform integer in [min, max], inclusive like GetRandomValue
+    int Int(int min, int max) {
+        if (min > max) std::swap(min, max);
+        uint32_t range = (uint32_t)(max - min) + 1u;
+        uint32_t threshold = (0u - range) % range;
+        uint32_t r;
+        do { r = Next(); } while (r < threshold);
+        return min + (int)(r % range);
+    }
+
+    uint64_t GetState() const { return state; }
+    uint64_t GetInc() const { return inc; }
+    void SetState(uint64_t s, uint64_t i) { state = s; inc = i; }
+};
@@ -0,0 +1,267 @@
+#pragma once
+// Runs the model on its own thread so that a slow tick never holds up a
+// frame and a slow frame never holds up the model. After each batch of
+// ticks the thread copies what the window draws into a WorldFrame and
+// publishes it through a triple buffer: neither side ever waits for the
+// other, and the window always picks up the newest complete frame. Key
+// commands travel the other way through a CommandQueue and go into the
+// model before its next tick.
+//
+// The model still advances in whole TICK_DT ticks, commands from a replay
+// are still applied at their recorded tick, and the trajectory recorder
+// still captures after every Step(), all on the simulation thread. Only
+// the window's view of the model is decoupled.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "simulation.h"
+#include "trajectory.h"
+
+// Never run more than this many ticks per wake-up; after a long stall the
+// model falls behind real time instead of spinning to catch up.
+constexpr int MAX_TICKS_PER_WAKE = 8;
+
+// --- PUBLISHED FRAME ---
+struct FrameVehicle {
+    float x, y;
+    float prevX, prevY;     // position at the start of the last tick
+    uint16_t flags;
+    uint8_t sprite;
+};
+
+struct FrameLight {
+    float x, y;
+    bool red;
+};
+
+struct FrameIncident {
+    IncidentState state;
+    float x, y;             // crash site, or the car about to be hit while pending; 0 if gone
+};
+
+// Everything the window reads from the model, copied out after a tick.
+// Vectors keep their storage from one publish to the next.
+struct WorldFrame {
+    uint32_t tick = 0;
+    bool ambulanceActive = false;
+    std::vector<FrameVehicle> vehicles;
+    std::vector<FrameLight> lights;
+    std::vector<FrameIncident> incidents;
+
+    // Clock for interpolating past the last tick: `carry` simulated seconds
+    // were already owed at `stepped`, and time runs at `rate` since then
+    // (0 while paused)
+    std::chrono::steady_clock::time_point stepped;
+    float carry = 0.0f;
+    float rate = 0.0f;
+
+    void Capture(const Simulation& sim) {
+        tick = sim.GetTick();
+        ambulanceActive = sim.IsAmbulanceActive();
+
+        vehicles.clear();
+        lights.clear();
+        for (int k = 0; k < sim.RoadCount(); k++) {
+            const Carriageway& road = sim.GetRoad(k);
+            const VehicleStore& s = road.vehicles;
+            for (uint32_t i = 0; i < s.Size(); i++) vehicles.push_back({ s.x[i], s.y[i], s.prevX[i], s.prevY[i], s.flags[i], s.sprite[i] });
+            for (const TrafficLight& light : road.lights) lights.push_back({ light.GetX(), light.GetY(), light.IsRed() });
+        }
+
+        incidents.clear();
+        const IncidentTable& table = sim.GetIncidents();
+        for (uint32_t slot = 0; slot < table.SlotCount(); slot++) {
+            if (!table.IsLive(slot)) continue;
+            const Incident& acc = table.At(slot);
+            FrameIncident inc = { acc.state, acc.x, acc.y };
+            if (acc.state == INCIDENT_PENDING && !sim.GetVehiclePosition(acc.car1, inc.x, inc.y)) inc.x = inc.y = 0.0f;
+            incidents.push_back(inc);
+        }
+    }
+
+    size_t CountIn(IncidentState state) const {
+        size_t n = 0;
+        for (const FrameIncident& inc : incidents) if (inc.state == state) n++;
+        return n;
+    }
+
+    // How far the window is between the last two ticks, 0..1
+    float Alpha(std::chrono::steady_clock::time_point now) const {
+        float since = std::chrono::duration<float>(now - stepped).count();
+        return std::min(1.0f, (carry + since * rate) / TICK_DT);
+    }
+};
+
+// --- TRIPLE BUFFER ---
+// One writer, one reader. The writer fills Back() and publishes it; the
+// reader swaps the newest published slot into Front(). The third slot
+// sits between them, so a publish never overwrites the frame being drawn.
+template <class T> class TripleBuffer {
+private:
+    static constexpr uint32_t FRESH = 4;    // set on `middle` when it holds an unread frame
+
+    T slots[3];
+    uint32_t back = 0;                      // writer's
+    uint32_t front = 1;                     // reader's
+    std::atomic<uint32_t> middle{ 2 };
+
+public:
+    T& Back() { return slots[back]; }
+    void Publish() { back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & 3; }
+
+    // Takes the newest published slot if there is one; false if Front() is already it
+    bool Update() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & 3;
+        return true;
+    }
+    const T& Front() const { return slots[front]; }
+};
+
+// --- COMMAND QUEUE ---
+// Single-producer, single-consumer ring. Push() fails when it is full,
+// which at one key press per frame only happens if the model has stalled.
+class CommandQueue {
+private:
+    static constexpr uint32_t CAPACITY = 64;
+
+    Command items[CAPACITY];
+    std::atomic<uint32_t> head{ 0 }, tail{ 0 };
+
+public:
+    bool Push(const Command& c) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == CAPACITY) return false;
+        items[t % CAPACITY] = c;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(Command& c) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        c = items[h % CAPACITY];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+// --- SIMULATION THREAD ---
+// Between Start() and Stop() the simulation belongs to this thread; the
+// caller must not touch it, and reads the model through Latest() instead.
+class SimulationThread {
+private:
+    Simulation& sim;
+    CommandLog* replay = nullptr;
+    TrajectoryRecorder* trajectory = nullptr;
+    TripleBuffer<WorldFrame> frames;
+    CommandQueue commands;
+    std::thread thread;
+    std::atomic<bool> stopping{ false };
+    std::atomic<bool> paused{ false };
+    std::atomic<float> timeScale{ 1.0f };
+    // The LOD focus is only a hint, so the two ends need not change together
+    std::atomic<bool> hasFocus{ false };
+    std::atomic<float> focusLeft{ 0.0f }, focusRight{ 0.0f };
+
+    void Publish(std::chrono::steady_clock::time_point stepped, float carry, float rate) {
+        PROFILE_SCOPE("sim.publish");
+        WorldFrame& frame = frames.Back();
+        frame.Capture(sim);
+        frame.stepped = stepped;
+        frame.carry = carry;
+        frame.rate = rate;
+        frames.Publish();
+    }
+
+    void Loop() {
+        using Clock = std::chrono::steady_clock;
+        Clock::time_point last = Clock::now();
+        float accumulator = 0.0f;
+        float rate = 0.0f;
+        while (!stopping.load(std::memory_order_acquire)) {
+            Clock::time_point now = Clock::now();
+            float real = std::chrono::duration<float>(now - last).count();
+            last = now;
+            float newRate = paused.load(std::memory_order_relaxed) ? 0.0f : timeScale.load(std::memory_order_relaxed);
+            accumulator += real * rate;
+            if (hasFocus.load(std::memory_order_relaxed)) sim.SetFocus(focusLeft.load(std::memory_order_relaxed), focusRight.load(std::memory_order_relaxed));
+
+            Command cmd;
+            while (commands.Pop(cmd)) sim.Submit(cmd);
+            int steps = 0;
+            while (accumulator >= TICK_DT && steps < MAX_TICKS_PER_WAKE) {
+                while (replay && replay->Pop(sim.GetTick(), cmd)) sim.Submit(cmd);
+                sim.Step();
+                if (trajectory && trajectory->IsOpen()) trajectory->Capture(sim);
+                accumulator -= TICK_DT;
+                steps++;
+            }
+            // Drop only the backlog that could not be run, keeping the
+            // fraction of a tick the window interpolates with
+            if (steps == MAX_TICKS_PER_WAKE && accumulator >= TICK_DT) accumulator = std::fmod(accumulator, TICK_DT);
+            // A pause or speed change also goes out, so the window stops or
+            // speeds up its interpolation with the model
+            if (steps > 0 || newRate != rate) Publish(now, accumulator, newRate);
+            rate = newRate;
+
+            // Sleep until the next tick is due; while paused, poll at the tick rate
+            float wait = rate > 0.0f ? (TICK_DT - accumulator) / rate : TICK_DT;
+            std::this_thread::sleep_for(std::chrono::duration<float>(wait));
+        }
+    }
+
+public:
+    explicit SimulationThread(Simulation& s) : sim(s) {}
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+    ~SimulationThread() { Stop(); }
+
+    // Commands to feed in at their recorded ticks
+    void SetReplay(CommandLog* log) { replay = log; }
+    // Captured after every tick
+    void SetTrajectory(TrajectoryRecorder* recorder) { trajectory = recorder; }
+
+    // Publishes the current state, so Latest() has a frame straight away,
+    // then starts ticking
+    void Start() {
+        if (thread.joinable()) return;
+        Publish(std::chrono::steady_clock::now(), 0.0f, 0.0f);
+        stopping.store(false, std::memory_order_release);
+        thread = std::thread(&SimulationThread::Loop, this);
+    }
+
+    // Returns once the thread has finished its current batch; the
+    // simulation is the caller's again afterwards
+    void Stop() {
+        if (!thread.joinable()) return;
+        stopping.store(true, std::memory_order_release);
+        thread.join();
+    }
+
+    // Applied before the next tick; false if the queue is full
+    bool Submit(CommandType type, const CommandArgs& args = CommandArgs()) { return commands.Push({ 0, type, args }); }
+
+    void SetClock(bool pause, float scale) {
+        paused.store(pause, std::memory_order_relaxed);
+        timeScale.store(scale, std::memory_order_relaxed);
+    }
+
+    void SetFocus(float left, float right) {
+        focusLeft.store(left, std::memory_order_relaxed);
+        focusRight.store(right, std::memory_order_relaxed);
+        hasFocus.store(true, std::memory_order_relaxed);
+    }
+
+    // Newest published frame; only the thread that called Start() may
+    // use it, and only until its next call
+    const WorldFrame& Latest() {
+        frames.Update();
+        return frames.Front();
+    }
+};
@@ -0,0 +1,1390 @@
+#pragma once
+// Traffic model shared by every front end. Nothing in here talks to raylib:
+// no window, no input, no textures, no audio. The window build and the
+// headless batch runner both drive the same Simulation through Step().
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include "world_config.h"
+#include "rng.h"
+#include "commands.h"
+#include "vehicle_store.h"
+#include "vehicle_kinds.h"
+#include "lane_index.h"
+#include "incidents.h"
+#include "thread_pool.h"
+#include "profiler.h"
+#include "snapshot.h"
+#include "kinematics.h"
+#include "flow_lanes.h"
+#include "timer_wheel.h"
+#include "metrics.h"
+
+// --- TIMING ---
+// The model always advances in fixed ticks. Speeds are in pixels per tick
+// and timers count TICK_DT per tick, so results never depend on frame rate.
+constexpr int TICKS_PER_SECOND = 60;
+constexpr float TICK_DT = 1.0f / TICKS_PER_SECOND;
+
+// Ticks a timer counting TICK_DT per tick takes to reach `seconds` (or to
+// pass it, when not inclusive). Uses the same float sums the state machines
+// once polled every tick, so every wait still ends on the same tick.
+inline uint32_t TicksUntil(float seconds, bool inclusive = true) {
+    float t = 0.0f;
+    uint32_t n = 0;
+    do { t += TICK_DT; n++; } while (inclusive ? t < seconds : t <= seconds);
+    return n;
+}
+
+// Largest gap any follower keeps to the vehicle ahead (tow trucks get 250 px),
+// plus slack for the few pixels vehicles move between two lane re-sorts.
+constexpr float MAX_FOLLOW_LIMIT = 250.0f;
+constexpr float LANE_SORT_SLACK = 32.0f;
+
+// Largest run of lane slots or dense indices handed to one pool task
+constexpr uint32_t TASK_CHUNK = 2048;
+constexpr size_t PARALLEL_MIN_VEHICLES = 2048;
+
+// --- LEVEL OF DETAIL ---
+// With level of detail on, cars stay fully simulated only this far around
+// what matters: the focus (the camera's view; the margin lets cars appear
+// before they come into sight), the stop line of each light (its queue),
+// each crash (cars swerving round it) and each special vehicle (cars
+// yielding to it). Everywhere else they run in the road's FlowLanes.
+constexpr float LOD_VIEW_MARGIN = 400.0f;
+constexpr float LOD_SIGNAL_REACH = 600.0f;
+constexpr float LOD_INCIDENT_REACH = 800.0f;
+constexpr float LOD_ESCORT_REACH = 600.0f;
+
+// How far behind a stop line a standing vehicle still counts as queued there
+constexpr float QUEUE_REACH = 1500.0f;
+
+// A stretch of road [left, right] simulated in detail
+struct DetailSpan {
+    float left, right;
+};
+
+enum AmbulanceState {
+    PATROL, TO_ACCIDENT, WAIT_AT_ACCIDENT, TO_HOSPITAL, WAIT_AT_HOSPITAL, LEAVING
+};
+
+enum BusState {
+    BUS_TO_SCHOOL, BUS_WAIT_AT_SCHOOL, BUS_LEAVING
+};
+
+// Which image a front end should use for a vehicle. The model only
+// carries the id; resolving it to a texture is the renderer's job.
+enum SpriteId {
+    SPRITE_CAR, SPRITE_CARS, SPRITE_CAR2, SPRITE_CAR3, SPRITE_CAR4,
+    SPRITE_AMBULANCE, SPRITE_DEPANNAGE, SPRITE_SCHOOL_BUS, SPRITE_COUNT
+};
+constexpr int CAR_SPRITE_COUNT = 5;
+
+// Changes colour every cycle on a timer the simulation schedules; the
+// light itself does nothing between changes
+class TrafficLight {
+private:
+    float x, y;
+    bool red;
+    uint32_t cycleTicks;
+public:
+    static constexpr float WIDTH = 30.0f;
+    static constexpr float HEIGHT = 80.0f;
+
+    TrafficLight(float posX, float posY, float cycle = 5.0f)
+        : x(posX), y(posY), red(true), cycleTicks(TicksUntil(cycle)) {}
+
+    void Toggle() { red = !red; }
+    uint32_t CycleTicks() const { return cycleTicks; }
+    // Takes effect from the next change, which is already on the timer wheel
+    void SetCycle(float seconds) { cycleTicks = TicksUntil(seconds); }
+
+    float GetX() const { return x; }
+    float GetY() const { return y; }
+    bool IsRed() const { return red; }
+    float GetStopLineX(bool rightToLeft) const {
+        return rightToLeft ? (x - 30) : (x + WIDTH + 30);
+    }
+
+    // Position comes from the config and the next change is on the timer
+    // wheel; the colour is state, and so is the cycle, which a command can change
+    template <class A> void Transfer(A& ar) {
+        ar.Value(red);
+        ar.Value(cycleTicks);
+    }
+};
+
+// --- SPECIAL VEHICLE STATE ---
+// Ambulances, tow trucks and school buses keep their state machines in
+// small side tables keyed by handle; everything else about them lives in
+// the carriageway's VehicleStore like any other vehicle. A waiting agent
+// has a timer on the wheel and wakeTick records when it fires.
+struct AmbulanceAgent {
+    VehicleHandle vehicle;
+    AmbulanceState state;
+    uint32_t wakeTick;
+    float accidentX, accidentY;
+    IncidentHandle incident;                // null while patrolling
+    uint32_t crashTick;                     // of its incident, for response times
+};
+
+struct TowAgent {
+    VehicleHandle vehicle;
+    bool hasPickedUp, isWorking;
+    float targetX;
+    uint32_t wakeTick;
+    IncidentHandle incident;
+};
+
+struct BusAgent {
+    VehicleHandle vehicle;
+    BusState state;
+    uint32_t wakeTick;
+    float schoolXLocation;
+};
+
+// Who a timer on the wheel belongs to. Signals carry road and light index;
+// the others carry their vehicle's handle (slot in index, generation in
+// generation) and are dropped if it has left the road by then.
+enum TimerKind : uint32_t { TIMER_SIGNAL, TIMER_AMBULANCE, TIMER_TOW, TIMER_BUS };
+
+// One road of the configured network: its vehicles, their lane index and
+// its lights. Every vehicle on it travels the same way.
+struct Carriageway {
+    VehicleStore vehicles;
+    LaneIndex lanes;
+    FlowLanes flow;                        // cars outside every detail span, with level of detail on
+    std::vector<DetailSpan> detail;
+    std::vector<TrafficLight> lights;
+    std::vector<uint8_t> stopDecision;     // per dense index, scratch for the decide pass
+    std::vector<float> laneY;
+    float y, height;
+    float worldWidth;
+    float followReach;                     // largest gap any follower here keeps
+    float spawnTimer = 0.0f;
+    bool dirRight, incidents;
+
+    Carriageway(const WorldConfig& cfg, const RoadConfig& road)
+        : lanes(vehicles, road.lanes, road.y + LANE_INSET, cfg.laneHeight), flow(road.lanes, road.dirRight), y(road.y), height(cfg.RoadHeight(road)),
+          worldWidth(cfg.worldWidth), followReach(road.incidents ? std::max(MAX_FOLLOW_LIMIT, cfg.safeDistance) : cfg.safeDistance),
+          dirRight(road.dirRight), incidents(road.incidents) {
+        vehicles.Reserve((uint32_t)cfg.roadCapacity);
+        lanes.Reserve((uint32_t)cfg.roadCapacity);
+        stopDecision.reserve(cfg.roadCapacity);
+        flow.Reserve((uint32_t)cfg.roadCapacity);
+        detail.reserve(1 + road.signals.size() + 3 * cfg.maxAccidents + 8);
+        for (int i = 0; i < road.lanes; i++) laneY.push_back(road.y + LANE_INSET + i * cfg.laneHeight);
+        for (const SignalConfig& sig : road.signals) lights.emplace_back(sig.x, sig.y, sig.cycleTime);
+    }
+
+    int LaneCount() const { return (int)laneY.size(); }
+    Carriageway(const Carriageway&) = delete;
+    Carriageway& operator=(const Carriageway&) = delete;
+
+    // The capacity covers the cars in the flow lanes as well
+    bool Full() const { return vehicles.Capacity() > 0 && vehicles.Size() + flow.Count() >= vehicles.Capacity(); }
+
+    // Null handle when the road is full
+    VehicleHandle Add(VehicleType kind, int spr, float x, float y, float speed, Tint col) {
+        if (Full()) return VehicleHandle{};
+        return Place(kind, spr, x, y, speed, col);
+    }
+
+    // Add without the capacity check, for a car leaving the flow lanes
+    VehicleHandle Place(VehicleType kind, int spr, float x, float y, float speed, Tint col) {
+        VehicleHandle h = vehicles.Add(kind, spr, x, y, speed, col, dirRight);
+        if (h.IsNull()) return h;
+        lanes.Insert(vehicles.Size() - 1);
+        return h;
+    }
+
+    void RemoveAt(uint32_t i) {
+        lanes.Remove(i);
+        if (vehicles.RemoveAt(i)) lanes.Moved(i);
+    }
+
+    template <class A> void Transfer(A& ar) {
+        vehicles.Transfer(ar);
+        if (!ar.Ok()) return;
+        lanes.Transfer(ar);
+        uint32_t count = (uint32_t)lights.size();
+        ar.Value(count);
+        ar.Check(count == lights.size(), "snapshot light count does not match the road");
+        if (count != lights.size()) return;
+        for (TrafficLight& light : lights) light.Transfer(ar);
+        ar.Value(spawnTimer);
+        flow.Transfer(ar, vehicles.Capacity() ? vehicles.Capacity() : UINT32_MAX);
+        ar.Array(detail);
+    }
+
+    bool IsOffScreen(uint32_t i) const {
+        return vehicles.Has(i, VF_DIR_RIGHT) ? vehicles.x[i] > worldWidth + 1500.0f : vehicles.x[i] < -1500;
+    }
+    // The same test for a car in the flow lanes, which all travel the road's way
+    bool IsOffScreenAt(float x) const {
+        return dirRight ? x > worldWidth + 1500.0f : x < -1500;
+    }
+
+    bool InDetail(float x) const {
+        for (const DetailSpan& span : detail) if (x >= span.left && x <= span.right) return true;
+        return false;
+    }
+};
+
+// Running totals for batch runs and reports.
+struct SimStats {
+    long long ticks = 0;
+    double simTime = 0.0;
+    long long spawned = 0;
+    long long despawned = 0;
+    long long dropped = 0;                 // spawns refused because the road was full
+    long long accidents = 0;
+    long long promoted = 0;                // flow cars turned back into vehicles
+    long long demoted = 0;                 // vehicles handed to the flow lanes
+    long long yields = 0;                  // lane changes to let an emergency vehicle by
+};
+
+// Vehicle pools summed over every road. The high-water mark is the most
+// vehicles any road held at once, added up; it tells how much of the
+// configured capacity a run really needed.
+struct PoolStats {
+    size_t capacity = 0;
+    size_t live = 0;
+    size_t highWater = 0;
+};
+
+// A contiguous piece of work for one pool task: slots [begin, end) of a
+// lane bucket, or dense indices [begin, end) when lane is -1
+struct WorkRange {
+    Carriageway* road;
+    int lane;
+    uint32_t begin, end;
+};
+
+// Two neighbours in one lane of the incident road that an accident could be
+// staged between: the follower is made to run into the leader. gap is the
+// distance between their positions when the pair was found.
+struct GapPair {
+    uint32_t follower, leader;
+    float gap;
+};
+
+class Simulation {
+private:
+    WorldConfig config;
+    std::vector<std::unique_ptr<Carriageway>> roads;
+    Carriageway* incident;                 // the road accidents and special vehicles use
+    float gapBehind[2 * VEHICLE_KIND_COUNT];   // by leader kind, then 1 if it moves
+    std::vector<AmbulanceAgent> ambulances;
+    std::vector<TowAgent> tows;
+    std::vector<BusAgent> buses;
+
+    // --- PARALLEL UPDATE ---
+    // Work lists for the pool, rebuilt every tick but reusing their storage
+    ThreadPool* pool = nullptr;
+    bool simd = true;                      // AVX2 car kinematics where the CPU has it
+    std::vector<WorkRange> laneWork, decideWork, moveWork;
+    std::vector<std::vector<uint32_t>> swerves;    // per lane of the incident road
+    std::vector<uint32_t> swerveYields;            // per lane, how many swerves are yields
+    std::vector<VehicleHandle> yieldFor;
+
+    // --- ACCIDENT CANDIDATES ---
+    // Per incident-road lane, the neighbouring pairs an accident could be
+    // staged between. Rebuilt with the lane order every tick, so picking
+    // one never has to search the road.
+    std::vector<std::vector<GapPair>> candidates;
+    std::vector<int> closestCandidate;             // per lane, index into candidates or -1
+
+    Rng rng;
+    uint32_t tick = 0;
+    std::vector<Command> pending;
+    CommandLog* recorder = nullptr;
+
+    // --- TIMERS ---
+    // Every scheduled state change. Lights change as soon as their timer
+    // fires; vehicle timers are held in `woken` until the vehicles have
+    // moved, where their per-tick polling used to notice them.
+    TimerWheel timers;
+    std::vector<TimerEvent> woken;
+    uint32_t waitAtAccidentTicks, waitAtHospitalTicks, towWorkTicks, busStopTicks;
+
+    // --- LEVEL OF DETAIL ---
+    // Set by the front end, like the thread pool; not part of a snapshot
+    bool lod = false;
+    float focusLeft = 0.0f, focusRight = 0.0f;
+    ResponseMetrics* metrics = nullptr;
+
+    // --- INCIDENTS ---
+    // Every accident under way, and the ones still waiting for an
+    // ambulance or a tow truck, oldest first
+    IncidentTable incidents;
+    DispatchQueue ambulanceQueue, towQueue;
+    SimStats stats;
+
+    // --- SNAPSHOT ---
+    // Everything Step() reads from one tick to the next. Work lists, swerve
+    // lists and stop decisions are rebuilt every tick and are left out;
+    // the accident candidates are kept because commands read them before
+    // the tick rebuilds them.
+    template <class A> void Transfer(A& ar) {
+        uint32_t roadCount = (uint32_t)roads.size();
+        ar.Value(roadCount);
+        ar.Check(roadCount == roads.size(), "snapshot road count does not match the world");
+        for (const auto& road : roads) if (ar.Ok()) road->Transfer(ar);
+
+        uint32_t limit = (uint32_t)config.roadCapacity;
+        ar.Records(ambulances, limit, [&](AmbulanceAgent& a) {
+            ar.Value(a.vehicle); ar.Value(a.state); ar.Value(a.wakeTick); ar.Value(a.accidentX); ar.Value(a.accidentY); ar.Value(a.incident);
+            ar.Value(a.crashTick);
+        });
+        ar.Records(tows, limit, [&](TowAgent& t) {
+            ar.Value(t.vehicle); ar.Value(t.hasPickedUp); ar.Value(t.isWorking); ar.Value(t.targetX); ar.Value(t.wakeTick); ar.Value(t.incident);
+        });
+        ar.Records(buses, limit, [&](BusAgent& b) {
+            ar.Value(b.vehicle); ar.Value(b.state); ar.Value(b.wakeTick); ar.Value(b.schoolXLocation);
+        });
+
+        for (std::vector<GapPair>& lane : candidates) ar.Array(lane, incident->vehicles.Size());
+        ar.Array(closestCandidate, (uint32_t)candidates.size());
+        ar.Check(closestCandidate.size() == candidates.size(), "snapshot candidate lists do not match the incident road");
+
+        uint64_t rngState = rng.GetState(), rngInc = rng.GetInc();
+        ar.Value(rngState); ar.Value(rngInc);
+        rng.SetState(rngState, rngInc);
+        ar.Value(tick);
+        ar.Records(pending, UINT32_MAX, [&](Command& c) { ar.Value(c.type); ar.Value(c.args); });
+        incidents.Transfer(ar);
+        ambulanceQueue.Transfer(ar);
+        towQueue.Transfer(ar);
+        timers.Transfer(ar);
+        ar.Value(stats);
+    }
+
+    // Small worlds are cheaper to step on one thread than to hand out
+    template <class F> void RunParallel(uint32_t count, const F& fn) {
+        if (pool && pool->Size() > 1 && count > 1 && VehicleCount() >= PARALLEL_MIN_VEHICLES) pool->Run(count, fn);
+        else for (uint32_t k = 0; k < count; k++) fn(k);
+    }
+
+    // Splits every lane of every road into chunks of at most `chunk` slots
+    void BuildLaneWork(std::vector<WorkRange>& work, uint32_t chunk) {
+        work.clear();
+        for (const auto& road : roads) {
+            for (int lane = 0; lane < road->LaneCount(); lane++) {
+                LaneView slots = road->lanes.Lane(lane);
+                const uint32_t end = (uint32_t)slots.End();
+                for (uint32_t b = (uint32_t)slots.Begin(); b < end; b += std::min(chunk, end - b)) work.push_back({ road.get(), lane, b, b + std::min(chunk, end - b) });
+            }
+        }
+    }
+
+    void BuildDenseWork(std::vector<WorkRange>& work, uint32_t chunk) {
+        work.clear();
+        for (const auto& road : roads) {
+            uint32_t n = road->vehicles.Size();
+            for (uint32_t b = 0; b < n; b += chunk) work.push_back({ road.get(), -1, b, std::min(n, b + chunk) });
+        }
+    }
+
+    template <class Agent> void PruneAgents(std::vector<Agent>& agents) {
+        uint32_t i;
+        agents.erase(std::remove_if(agents.begin(), agents.end(), [&](const Agent& a) { return !incident->vehicles.Resolve(a.vehicle, i); }), agents.end());
+    }
+
+    float SpawnX(const Carriageway& road) const { return road.dirRight ? -1500.0f : config.worldWidth + 1500.0f; }
+    float CarSpeed() { return config.carMinSpeed + rng.Int(0, (int)std::lround((config.carMaxSpeed - config.carMinSpeed) * 10.0f)) / 10.0f; }
+    float SpawnDelay() { return rng.Int((int)std::lround(config.spawnMinDelay * 10.0f), (int)std::lround(config.spawnMaxDelay * 10.0f)) / 10.0f; }
+    int LastLane() const { return incident->LaneCount() - 1; }
+
+public:
+    // The config must have passed validation: exactly one incidents road
+    explicit Simulation(const WorldConfig& cfg = WorldConfig()) : config(cfg) {
+        for (const RoadConfig& road : config.roads) roads.push_back(std::make_unique<Carriageway>(config, road));
+        incident = roads[config.IncidentRoad()].get();
+        // Per-lane scratch can hold a whole road, so a tick never grows it
+        swerves.resize(incident->LaneCount());
+        swerveYields.resize(incident->LaneCount());
+        candidates.resize(incident->LaneCount());
+        for (std::vector<uint32_t>& lane : swerves) lane.reserve(config.roadCapacity);
+        for (std::vector<GapPair>& lane : candidates) lane.reserve(config.roadCapacity);
+        // Incidents and their responders are bounded by the accident limit
+        incidents.Reserve(config.maxAccidents);
+        ambulanceQueue.Reserve(config.maxAccidents);
+        towQueue.Reserve(config.maxAccidents);
+        ambulances.reserve(config.maxAccidents + 1);
+        tows.reserve(config.maxAccidents);
+        buses.reserve(4);
+        yieldFor.reserve(2 * config.maxAccidents + 1);
+        closestCandidate.assign(incident->LaneCount(), -1);
+        for (int kind = 0; kind < VEHICLE_KIND_COUNT; kind++) {
+            for (int moving = 0; moving < 2; moving++) {
+                gapBehind[kind * 2 + moving] = ForKind((uint8_t)kind, [&](auto k) { return decltype(k)::GapBehind(config, moving != 0); });
+            }
+        }
+
+        waitAtAccidentTicks = TicksUntil(config.ambulanceWaitAtAccident);
+        waitAtHospitalTicks = TicksUntil(config.ambulanceWaitAtHospital);
+        towWorkTicks = TicksUntil(config.towWorkTime, false);
+        busStopTicks = TicksUntil(config.busStopTime);
+        // One timer per light, plus one per waiting agent
+        size_t lightCount = 0;
+        for (const auto& road : roads) lightCount += road->lights.size();
+        timers.Reserve(lightCount + 2 * config.maxAccidents + 8);
+        woken.reserve(2 * config.maxAccidents + 8);
+        // A light's timer counts from the first tick, so its first change
+        // falls on tick cycle - 1 and every later one a cycle after that
+        for (uint32_t r = 0; r < roads.size(); r++) {
+            for (uint32_t k = 0; k < roads[r]->lights.size(); k++) timers.Schedule(roads[r]->lights[k].CycleTicks() - 1, { TIMER_SIGNAL, r, k, 0 });
+        }
+    }
+
+    void Init(uint64_t seed) {
+        rng.Seed(seed);
+    }
+
+    // Queues a user command; it takes effect at the start of the next tick.
+    // One whose arguments Accepts() refuses is recorded but does nothing.
+    void Submit(CommandType type, const CommandArgs& args = CommandArgs()) { pending.push_back({ 0, type, args }); }
+    void Submit(const Command& c) { Submit(c.type, c.args); }
+
+    // Whether a command's arguments fit this world
+    bool Accepts(CommandType type, const CommandArgs& a) const {
+        switch (type) {
+            case CMD_SPAWN_CARS:
+                return a.road < roads.size() && a.index < roads[a.road]->LaneCount() && a.count >= 1 && a.count <= (uint32_t)config.roadCapacity;
+            case CMD_ACCIDENT_AT:
+                return std::isfinite(a.value);
+            case CMD_SET_SIGNAL_CYCLE:
+                return a.road < roads.size() && a.index < roads[a.road]->lights.size() && a.value >= 0.1f && a.value <= 3600.0f;
+            default:
+                return type < CMD_COUNT;
+        }
+    }
+
+    // Every command applied from now on is appended to the log with its tick
+    void SetRecorder(CommandLog* log) { recorder = log; }
+
+    // Runs the per-lane and per-vehicle phases of Step() on a pool. The
+    // result is identical with or without one, whatever its size.
+    void SetThreadPool(ThreadPool* p) { pool = p; }
+
+    // Moves plain cars with the vector kernel when available (the default)
+    // or one at a time. Both give the same state, so this only costs time.
+    void SetSimd(bool on) { simd = on; }
+
+    // Level of detail: only the stretches around the focus, the lights,
+    // crashes and special vehicles are simulated car by car; elsewhere cars
+    // queue in cheap per-lane flows and turn back into vehicles as a span
+    // reaches them. The run stays deterministic for a given sequence of
+    // focus updates, but differs from a run without level of detail.
+    void SetLevelOfDetail(bool on) { lod = on; }
+    bool GetLevelOfDetail() const { return lod; }
+    // The world X range the front end shows, usually the camera's view
+    void SetFocus(float left, float right) { focusLeft = left; focusRight = right; }
+    const char* GetKinematicsPath() const { return KinematicsPath(simd); }
+
+    // Response, hospital and clearance times of every crash from now on
+    // are added to m, in ticks from the crash
+    void SetMetrics(ResponseMetrics* m) { metrics = m; }
+
+    uint32_t GetTick() const { return tick; }
+
+    // Index of the incident-road lane a vehicle currently sits in, judged by its Y
+    int LaneFromY(float y) const {
+        int currentLaneIdx = 0;
+        for (int k = 1; k < incident->LaneCount(); k++) if (fabs(y - incident->laneY[k]) < 5) currentLaneIdx = k;
+        return currentLaneIdx;
+    }
+
+    // Moves an incident-road vehicle one lane over to get out of the way
+    void Swerve(uint32_t i) {
+        VehicleStore& s = incident->vehicles;
+        int targetLane = (LaneFromY(s.y[i]) + 1) % incident->LaneCount();
+        s.targetY[i] = incident->laneY[targetLane]; s.Set(i, VF_CHANGED_LANE, true);
+        incident->lanes.Relane(i);
+    }
+
+    bool CanSwerve(uint32_t i) const {
+        return !incident->vehicles.Has(i, VF_CRASHED | VF_TOWED | VF_RECKLESS | VF_LANE_LOCK | VF_CHANGED_LANE);
+    }
+
+    // Vehicles up to 450 px in front of an emergency vehicle, in its lane, move over.
+    // Only collects them; nothing changes until the swerves are merged.
+    void CollectYields(int laneIdx, VehicleHandle emergency, std::vector<uint32_t>& out) const {
+        const VehicleStore& s = incident->vehicles;
+        uint32_t e;
+        if (!s.Resolve(emergency, e) || s.laneIndex[e] != laneIdx) return;
+        LaneView lane = incident->lanes.Lane(laneIdx);
+        for (size_t k = incident->lanes.LowerBound(laneIdx, s.x[e] - 450.0f - LANE_SORT_SLACK); k < lane.End(); k++) {
+            uint32_t v = lane[k];
+            float dist = s.x[e] - s.x[v];
+            if (dist < -LANE_SORT_SLACK) break;
+            if (dist > 0 && dist < 450.0f && CanSwerve(v) && fabs(s.targetY[v] - s.targetY[e]) < 5.0f) out.push_back(v);
+        }
+    }
+
+    // Vehicles closing in on a standing accident within 300 px change lanes
+    void CollectAvoiders(int laneIdx, std::vector<uint32_t>& out) const {
+        const VehicleStore& s = incident->vehicles;
+        LaneView lane = incident->lanes.Lane(laneIdx);
+        for (uint32_t slot = 0; slot < incidents.SlotCount(); slot++) {
+            if (!incidents.IsLive(slot)) continue;
+            const Incident& acc = incidents.At(slot);
+            if (acc.state != INCIDENT_ACTIVE || incident->lanes.LaneFor(acc.y) != laneIdx) continue;
+            for (size_t k = incident->lanes.LowerBound(laneIdx, acc.x - LANE_SORT_SLACK); k < lane.End(); k++) {
+                uint32_t v = lane[k];
+                if (s.x[v] - acc.x >= 300 + LANE_SORT_SLACK) break;
+                if (CanSwerve(v) && fabs(s.y[v] - acc.y) < 5.0f && s.x[v] > acc.x && s.x[v] - acc.x < 300) out.push_back(v);
+            }
+        }
+    }
+
+    // Whether `other` is ahead of v, a vehicle of kind Kind, in its lane and
+    // too close to keep going
+    template <class Kind> bool FollowBlocks(const Carriageway& road, uint32_t v, uint32_t other) const {
+        const VehicleStore& s = road.vehicles;
+        if (s.Has(other, VF_TOWED)) return false;
+        if (Kind::PASSES_WRECKS && s.Has(other, VF_CRASHED | VF_ACCIDENT_TARGET)) return false;
+        if (fabs(s.targetY[v] - s.targetY[other]) >= 5.0f) return false;
+
+        float distToFront;
+        if (road.dirRight) {
+            if (s.x[other] <= s.x[v]) return false;
+            distToFront = s.x[other] - VEHICLE_WIDTH - s.x[v];
+        } else {
+            if (s.x[other] >= s.x[v]) return false;
+            distToFront = s.x[v] - (s.x[other] + VEHICLE_WIDTH);
+        }
+        return distToFront < FollowLimit<Kind>(s, other);
+    }
+
+    // Gap a vehicle of kind Kind keeps behind `other`
+    template <class Kind> float FollowLimit(const VehicleStore& s, uint32_t other) const {
+        if (Kind::CLOSE_FOLLOW) return CLOSE_FOLLOW_GAP;
+        return gapBehind[s.type[other] * 2 + ((s.flags[other] & VF_MOVING) ? 1 : 0)];
+    }
+
+    // Scans the lane ahead of v up to the road's follow reach, then the few
+    // slots behind it that may be stale since the last re-sort
+    template <class Kind> bool MustStop(const Carriageway& road, uint32_t v) const {
+        const VehicleStore& s = road.vehicles;
+        LaneView lane = road.lanes.Lane(s.laneIndex[v]);
+        const float reach = road.followReach + LANE_SORT_SLACK;
+        if (road.dirRight) {
+            for (size_t k = s.laneSlot[v] + 1; k < lane.End(); k++) {
+                uint32_t other = lane[k];
+                if (s.x[other] - VEHICLE_WIDTH - s.x[v] >= reach) break;
+                if (FollowBlocks<Kind>(road, v, other)) return true;
+            }
+            for (int k = s.laneSlot[v] - 1; k >= (int)lane.Begin(); k--) {
+                uint32_t other = lane[k];
+                if (s.x[v] - s.x[other] > LANE_SORT_SLACK) break;
+                if (FollowBlocks<Kind>(road, v, other)) return true;
+            }
+        } else {
+            for (int k = s.laneSlot[v] - 1; k >= (int)lane.Begin(); k--) {
+                uint32_t other = lane[k];
+                if (s.x[v] - s.x[other] - VEHICLE_WIDTH >= reach) break;
+                if (FollowBlocks<Kind>(road, v, other)) return true;
+            }
+            for (size_t k = s.laneSlot[v] + 1; k < lane.End(); k++) {
+                uint32_t other = lane[k];
+                if (s.x[other] - s.x[v] > LANE_SORT_SLACK) break;
+                if (FollowBlocks<Kind>(road, v, other)) return true;
+            }
+        }
+        return false;
+    }
+
+    // --- LEVEL OF DETAIL ---
+    bool Detailed(const Carriageway& road, float x) const { return !lod || road.InDetail(x); }
+
+    // A new plain car goes wherever its position says; bulk adds are
+    // appended and the caller sorts the lanes once
+    bool AddCar(Carriageway& road, int lane, float x, float speed, int spr, Tint c, bool bulk) {
+        if (Detailed(road, x)) return !road.Add(VEHICLE_CAR, spr, x, road.laneY[lane], speed, c).IsNull();
+        if (road.Full()) return false;
+        FlowCar car = { x, speed, (uint16_t)(VF_MOVING | (road.dirRight ? VF_DIR_RIGHT : 0)), (uint8_t)spr, 0, c };
+        if (bulk) road.flow.Append(lane, car); else road.flow.Insert(lane, car);
+        return true;
+    }
+
+    // Whether the nearest flow car ahead of v, in its lane, is too close to keep going
+    template <class Kind> bool FlowBlocks(const Carriageway& road, uint32_t v) const {
+        if (road.flow.Empty()) return false;
+        const VehicleStore& s = road.vehicles;
+        int lane = s.laneIndex[v];
+        size_t ahead = road.flow.AheadOf(lane, s.x[v]);
+        if (ahead == 0) return false;
+        float x = road.flow.Lane(lane)[ahead - 1].x;
+        float distToFront = road.dirRight ? x - VEHICLE_WIDTH - s.x[v] : s.x[v] - (x + VEHICLE_WIDTH);
+        return distToFront < (Kind::CLOSE_FOLLOW ? CLOSE_FOLLOW_GAP : config.safeDistance);
+    }
+
+    // Whether a vehicle ahead of a flow car at x, in the given lane, is too close to keep going
+    bool DetailBlocksFlow(const Carriageway& road, int lane, float x) const {
+        const VehicleStore& s = road.vehicles;
+        LaneView bucket = road.lanes.Lane(lane);
+        if (bucket.Empty()) return false;
+        const float reach = road.followReach + VEHICLE_WIDTH + LANE_SORT_SLACK;
+        const float from = road.dirRight ? x - LANE_SORT_SLACK : x - reach;
+        const float to = road.dirRight ? x + reach : x + LANE_SORT_SLACK;
+        for (size_t k = road.lanes.LowerBound(lane, from); k < bucket.End() && s.x[bucket[k]] <= to; k++) {
+            uint32_t other = bucket[k];
+            if (s.Has(other, VF_TOWED)) continue;
+            if (road.dirRight ? s.x[other] <= x : s.x[other] >= x) continue;
+            float distToFront = road.dirRight ? s.x[other] - VEHICLE_WIDTH - x : x - (s.x[other] + VEHICLE_WIDTH);
+            if (distToFront < FollowLimit<KindPolicy<VEHICLE_CAR>>(s, other)) return true;
+        }
+        return false;
+    }
+
+    // The stretches of one road to simulate in detail this tick
+    void BuildDetailSpans(Carriageway& road) {
+        road.detail.clear();
+        road.detail.push_back({ focusLeft - LOD_VIEW_MARGIN, focusRight + LOD_VIEW_MARGIN });
+        auto around = [&](float x, float reach) { road.detail.push_back({ x - reach, x + reach }); };
+        for (const TrafficLight& light : road.lights) around(light.GetStopLineX(!road.dirRight), LOD_SIGNAL_REACH);
+        if (!road.incidents) return;
+        for (uint32_t slot = 0; slot < incidents.SlotCount(); slot++) {
+            if (incidents.IsLive(slot) && incidents.At(slot).state != INCIDENT_PENDING) around(incidents.At(slot).x, LOD_INCIDENT_REACH);
+        }
+        const VehicleStore& s = road.vehicles;
+        uint32_t i;
+        for (const AmbulanceAgent& a : ambulances) if (s.Resolve(a.vehicle, i)) around(s.x[i], LOD_ESCORT_REACH);
+        for (const TowAgent& t : tows) if (s.Resolve(t.vehicle, i)) around(s.x[i], LOD_ESCORT_REACH);
+        for (const BusAgent& b : buses) if (s.Resolve(b.vehicle, i)) around(s.x[i], LOD_ESCORT_REACH);
+    }
+
+    // Plain cars outside every span, settled in their lane and not part of
+    // an accident, leave the store for the flow lanes. Walks backwards like
+    // Despawn.
+    void DemoteOutside(Carriageway& road) {
+        VehicleStore& s = road.vehicles;
+        for (uint32_t i = s.Size(); i-- > 0;) {
+            if (s.type[i] != VEHICLE_CAR || s.Has(i, VF_CRASHED | VF_TOWED | VF_RECKLESS | VF_ACCIDENT_TARGET | VF_LANE_LOCK)) continue;
+            if (s.y[i] != s.targetY[i] || Detailed(road, s.x[i])) continue;
+            FlowCar car = { s.x[i], s.speed[i], (uint16_t)(s.flags[i] & ~VF_FORCED_STOP), s.sprite[i], 0, s.color[i] };
+            road.flow.Insert(s.laneIndex[i], car);
+            road.RemoveAt(i);
+            stats.demoted++;
+        }
+    }
+
+    // One tick of the flow lanes, front car first: cars past the end of the
+    // road leave, cars inside a span become vehicles where they stand (they
+    // move with the others later this tick), the rest advance unless the
+    // car or vehicle ahead is within the safe distance
+    void StepFlow(Carriageway& road) {
+        for (int lane = 0; lane < road.flow.LaneCount(); lane++) {
+            std::vector<FlowCar>& cars = road.flow.Lane(lane);
+            size_t kept = 0;
+            for (size_t k = 0; k < cars.size(); k++) {
+                FlowCar car = cars[k];
+                if (road.IsOffScreenAt(car.x)) { stats.despawned++; continue; }
+                if (Detailed(road, car.x) && !road.Place(VEHICLE_CAR, car.sprite, car.x, road.laneY[lane], car.speed, car.color).IsNull()) {
+                    road.vehicles.flags[road.vehicles.Size() - 1] = car.flags;
+                    stats.promoted++;
+                    continue;
+                }
+                bool blocked = false;
+                if (kept > 0) {
+                    float leader = cars[kept - 1].x;
+                    blocked = (road.dirRight ? leader - VEHICLE_WIDTH - car.x : car.x - (leader + VEHICLE_WIDTH)) < config.safeDistance;
+                }
+                if (!blocked) blocked = DetailBlocksFlow(road, lane, car.x);
+                if (!blocked) car.x += road.dirRight ? car.speed : -car.speed;
+                cars[kept++] = car;
+            }
+            road.flow.Truncate(lane, kept);
+        }
+    }
+
+    void SpawnCar(Carriageway& road) {
+        int lane = rng.Int(0, road.LaneCount() - 1);
+        float speed = CarSpeed();
+        Tint c = { (unsigned char)rng.Int(80, 255), (unsigned char)rng.Int(80, 255), (unsigned char)rng.Int(80, 255), 255 };
+        int spr = SPRITE_CAR + rng.Int(0, CAR_SPRITE_COUNT - 1);
+        if (AddCar(road, lane, SpawnX(road), speed, spr, c, false)) stats.spawned++;
+        else stats.dropped++;
+    }
+    // Lines cars up behind one lane's spawn point, each behind the last car
+    // already in the lane if that one has not got clear of it yet, so a
+    // burst never stacks cars on top of each other
+    void SpawnCars(Carriageway& road, int lane, uint32_t count) {
+        const float spacing = VEHICLE_WIDTH + config.safeDistance + 10.0f;
+        // Positions along the direction of travel, so "behind" is always smaller
+        const float dir = road.dirRight ? 1.0f : -1.0f;
+        float at = dir * SpawnX(road);
+        for (uint32_t v : road.lanes.Lane(lane)) at = std::min(at, dir * road.vehicles.x[v] - spacing);
+        for (const FlowCar& car : road.flow.Lane(lane)) at = std::min(at, dir * car.x - spacing);
+        for (uint32_t k = 0; k < count; k++, at -= spacing) {
+            float speed = CarSpeed();
+            Tint c = { (unsigned char)rng.Int(80, 255), (unsigned char)rng.Int(80, 255), (unsigned char)rng.Int(80, 255), 255 };
+            int spr = SPRITE_CAR + rng.Int(0, CAR_SPRITE_COUNT - 1);
+            if (AddCar(road, lane, dir * at, speed, spr, c, false)) stats.spawned++;
+            else stats.dropped++;
+        }
+    }
+    // Special vehicles check for room before they touch any queue, so a
+    // full road leaves the call unanswered rather than half-dispatched
+    bool IncidentRoadFull() {
+        if (!incident->Full()) return false;
+        stats.dropped++;
+        return true;
+    }
+    void CallSchoolBus() {
+        if (IncidentRoadFull()) return;
+        VehicleHandle h = incident->Add(VEHICLE_SCHOOL_BUS, SPRITE_SCHOOL_BUS, SpawnX(*incident), incident->laneY[LastLane()], config.busSpeed, { 253, 249, 0, 255 });
+        buses.push_back({ h, BUS_TO_SCHOOL, 0, config.schoolX });
+        stats.spawned++;
+    }
+
+    // Lines `count` extra cars up behind the spawn points, round-robin over
+    // roads and lanes, far enough apart to brake. Used by benchmarks and
+    // stress runs. Cars are added in increasing X on every road so lane
+    // inserts append.
+    void Populate(int count) {
+        const float spacing = VEHICLE_WIDTH + config.safeDistance + 10.0f;
+        const int roadCount = (int)roads.size();
+        for (int k = 0; k < count; k++) {
+            Carriageway& road = *roads[k % roadCount];
+            int nth = k / roadCount, lanes = road.LaneCount();
+            int lane = nth % lanes;
+            int row = nth / lanes;
+            int onRoad = (count - k % roadCount + roadCount - 1) / roadCount;
+            int rows = (onRoad + lanes - 1) / lanes;
+            float back = (road.dirRight ? rows - 1 - row : row) * spacing;
+            float speed = CarSpeed();
+            Tint c = { (unsigned char)rng.Int(80, 255), (unsigned char)rng.Int(80, 255), (unsigned char)rng.Int(80, 255), 255 };
+            float x = road.dirRight ? SpawnX(road) - spacing - back : SpawnX(road) + spacing + back;
+            if (AddCar(road, lane, x, speed, SPRITE_CAR + rng.Int(0, CAR_SPRITE_COUNT - 1), c, true)) stats.spawned++;
+            else stats.dropped++;
+        }
+        for (const auto& road : roads) road->flow.Sort();
+    }
+
+    bool CanCrash(uint32_t i) const {
+        const VehicleStore& s = incident->vehicles;
+        return s.type[i] == VEHICLE_CAR && !incident->IsOffScreen(i) && !s.Has(i, VF_TOWED | VF_CRASHED | VF_RECKLESS | VF_ACCIDENT_TARGET);
+    }
+
+    // Whether an accident can be staged between these two cars right now
+    bool IsCandidate(uint32_t follower, uint32_t leader) const {
+        const VehicleStore& s = incident->vehicles;
+        if (follower >= s.Size() || leader >= s.Size() || !CanCrash(follower) || !CanCrash(leader)) return false;
+        // The last lane is kept clear for the bus and the run to the hospital
+        if (LastLane() > 0 && s.laneIndex[follower] == LastLane()) return false;
+        if (fabs(s.targetY[follower] - s.targetY[leader]) >= 5.0f) return false;
+        float dist = s.x[follower] - s.x[leader];
+        return dist < 400 && dist > 110 && s.x[follower] < config.worldWidth - 100 && s.x[leader] > 100;
+    }
+
+    // Collects the candidate pairs of one lane from its sorted bucket. Only
+    // writes that lane's entries, so lanes can be refreshed in parallel.
+    void RefreshCandidates(int lane) {
+        const VehicleStore& s = incident->vehicles;
+        LaneView bucket = incident->lanes.Lane(lane);
+        std::vector<GapPair>& out = candidates[lane];
+        int& closest = closestCandidate[lane];
+        out.clear();
+        closest = -1;
+        // The incident road runs right to left: the leader has the smaller X
+        for (size_t k = bucket.Begin() + 1; k < bucket.End(); k++) {
+            uint32_t leader = bucket[k - 1], follower = bucket[k];
+            if (!IsCandidate(follower, leader)) continue;
+            float gap = s.x[follower] - s.x[leader];
+            if (closest < 0 || gap < out[closest].gap) closest = (int)out.size();
+            out.push_back({ follower, leader, gap });
+        }
+    }
+
+    const GapPair& CandidateAt(size_t k) const {
+        size_t lane = 0;
+        while (k >= candidates[lane].size()) k -= candidates[lane++].size();
+        return candidates[lane][k];
+    }
+
+    // Sets two cars of one lane on a collision course, unless the incident
+    // table is already at the configured limit. The pair is drawn at random
+    // from the candidates; the cars have moved since those were collected,
+    // so a pair that no longer qualifies passes the turn to the next one.
+    void TriggerRandomAccident() {
+        if (incidents.Count() >= (size_t)config.maxAccidents) return;
+        size_t total = 0;
+        for (const std::vector<GapPair>& lane : candidates) total += lane.size();
+        if (total == 0) return;
+        size_t k = (size_t)rng.Int(0, (int)total - 1);
+        for (size_t n = 0; n < total; n++, k = (k + 1) % total) {
+            const GapPair& pair = CandidateAt(k);
+            if (!IsCandidate(pair.follower, pair.leader)) continue;
+            StageAccident(pair.follower, pair.leader);
+            return;
+        }
+    }
+    // Same, with the pair whose leader is closest to world X x
+    void TriggerAccidentAt(float x) {
+        if (incidents.Count() >= (size_t)config.maxAccidents) return;
+        const VehicleStore& s = incident->vehicles;
+        const GapPair* best = nullptr;
+        for (const std::vector<GapPair>& lane : candidates) {
+            for (const GapPair& pair : lane) {
+                if (!IsCandidate(pair.follower, pair.leader)) continue;
+                if (!best || fabs(s.x[pair.leader] - x) < fabs(s.x[best->leader] - x)) best = &pair;
+            }
+        }
+        if (best) StageAccident(best->follower, best->leader);
+    }
+    // Follower i speeds into leader j, which slows down
+    void StageAccident(uint32_t i, uint32_t j) {
+        VehicleStore& s = incident->vehicles;
+        Incident acc;
+        acc.car1 = s.HandleOf(j); acc.car2 = s.HandleOf(i);
+        incidents.Open(acc);
+        s.Set(i, VF_RECKLESS | VF_LANE_LOCK, true); s.Set(j, VF_ACCIDENT_TARGET | VF_LANE_LOCK, true);
+        s.speed[i] *= 2.8f; s.speed[j] *= 0.4f;
+    }
+    // The new ambulance patrols until dispatch hands it an incident. With
+    // nothing under way it provokes an accident for itself.
+    void CallAmbulance() {
+        if (IncidentRoadFull()) return;
+        if (incidents.Count() == 0) TriggerRandomAccident();
+        VehicleHandle h = incident->Add(VEHICLE_AMBULANCE, SPRITE_AMBULANCE, SpawnX(*incident), incident->laneY[std::min(1, LastLane())], config.ambulanceSpeed, { 245, 245, 245, 255 });
+        ambulances.push_back({ h, PATROL, 0, 0.0f, 0.0f, IncidentHandle{}, 0 });
+        stats.spawned++;
+    }
+    // Sends a tow truck to the oldest crash that has none yet
+    void CallDepannage() {
+        IncidentHandle target;
+        if (IncidentRoadFull() || !towQueue.Pop(incidents, target)) return;
+        Incident& acc = *incidents.Get(target);
+        VehicleHandle h = incident->Add(VEHICLE_DEPANNAGE, SPRITE_DEPANNAGE, SpawnX(*incident), acc.y, config.towSpeed, { 255, 161, 0, 255 });
+        tows.push_back({ h, false, false, acc.x, 0, target });
+        acc.tow = h;
+        stats.spawned++;
+    }
+
+    // --- DESPAWN ---
+    // Incidents notice their vehicles are gone through the handles; nothing
+    // here has to reach back into the incident table
+    bool ShouldDespawnIncident(uint32_t i) const {
+        const VehicleStore& s = incident->vehicles;
+        if (s.type[i] == VEHICLE_DEPANNAGE) return s.x[i] < -3000.0f;
+        if (s.type[i] == VEHICLE_SCHOOL_BUS) return incident->IsOffScreen(i);
+        if (s.Has(i, VF_RECKLESS | VF_ACCIDENT_TARGET | VF_CRASHED | VF_TOWED)) return s.x[i] <= -2000.0f || s.Has(i, VF_TO_BE_REMOVED);
+        return incident->IsOffScreen(i) || s.Has(i, VF_TO_BE_REMOVED);
+    }
+
+    void Despawn() {
+        PROFILE_SCOPE("sim.despawn");
+        // Walk backwards so the vehicle swapped into a freed index was already checked
+        for (const auto& road : roads) {
+            for (uint32_t i = road->vehicles.Size(); i-- > 0;) {
+                bool despawn = road->incidents ? ShouldDespawnIncident(i) : road->IsOffScreen(i);
+                if (despawn) { road->RemoveAt(i); stats.despawned++; }
+            }
+        }
+        PruneAgents(ambulances); PruneAgents(tows); PruneAgents(buses);
+    }
+
+    // --- SPECIAL VEHICLE PASSES ---
+    // Parks an agent until `ticks` from now; its timer wakes it in WakeAgents
+    void Sleep(TimerKind kind, VehicleHandle vehicle, uint32_t& wakeTick, uint32_t ticks) {
+        wakeTick = tick + ticks;
+        timers.Schedule(wakeTick, { kind, vehicle.slot, 0, vehicle.generation });
+    }
+
+    void UpdateAmbulances() {
+        VehicleStore& s = incident->vehicles;
+        for (AmbulanceAgent& a : ambulances) {
+            uint32_t i;
+            if (!s.Resolve(a.vehicle, i)) continue;
+            float& x = s.x[i];
+            float speed = s.speed[i];
+            switch (a.state) {
+                case PATROL: StepFreeFlow(s, i); continue;
+                case TO_ACCIDENT:
+                    if (s.Has(i, VF_DIR_RIGHT)) x += speed; else x -= speed;
+                    if (x <= a.accidentX + 160.0f) {
+                        x = a.accidentX + 160.0f; a.state = WAIT_AT_ACCIDENT; s.Set(i, VF_MOVING, false);
+                        Sleep(TIMER_AMBULANCE, a.vehicle, a.wakeTick, waitAtAccidentTicks);
+                        if (metrics) metrics->response.Add(tick - a.crashTick);
+                    }
+                    break;
+                case TO_HOSPITAL:
+                    if (!s.Has(i, VF_FORCED_STOP)) {
+                        if (x > config.hospitalX) x -= speed;
+                        else {
+                            a.state = WAIT_AT_HOSPITAL; s.Set(i, VF_MOVING, false); Sleep(TIMER_AMBULANCE, a.vehicle, a.wakeTick, waitAtHospitalTicks);
+                            if (metrics) metrics->hospital.Add(tick - a.crashTick);
+                        }
+                    }
+                    break;
+                case LEAVING: x -= speed; break;
+                default: break;                     // waiting on its timer
+            }
+            BlendLane(s, i);
+        }
+    }
+
+    void UpdateTows() {
+        VehicleStore& s = incident->vehicles;
+        for (TowAgent& t : tows) {
+            uint32_t i;
+            if (!s.Resolve(t.vehicle, i)) continue;
+            if (t.isWorking) continue;              // waiting on its timer
+            if (!t.hasPickedUp && s.x[i] <= t.targetX - 120) {
+                t.isWorking = true; s.Set(i, VF_MOVING, false);
+                Sleep(TIMER_TOW, t.vehicle, t.wakeTick, towWorkTicks);
+                continue;
+            }
+            if (t.hasPickedUp) { StepFreeFlow(s, i); continue; }
+            // On the way out it has priority like the ambulance: with several
+            // crashes on the road, the queue behind one must not hold up its own tow
+            s.x[i] -= s.speed[i];
+            BlendLane(s, i);
+        }
+    }
+
+    void UpdateBuses() {
+        VehicleStore& s = incident->vehicles;
+        for (BusAgent& b : buses) {
+            uint32_t i;
+            if (!s.Resolve(b.vehicle, i)) continue;
+            if (b.state != BUS_WAIT_AT_SCHOOL && !s.Has(i, VF_FORCED_STOP)) {
+                if (b.state == BUS_TO_SCHOOL) {
+                    s.x[i] -= s.speed[i];
+                    if (s.x[i] <= b.schoolXLocation) {
+                        s.x[i] = b.schoolXLocation; b.state = BUS_WAIT_AT_SCHOOL;
+                        Sleep(TIMER_BUS, b.vehicle, b.wakeTick, busStopTicks);
+                    }
+                } else if (b.state == BUS_LEAVING) s.x[i] -= s.speed[i];
+            }
+            BlendLane(s, i);
+        }
+    }
+
+    template <class Agent> Agent* FindAgent(std::vector<Agent>& agents, const TimerEvent& e) {
+        VehicleHandle h{ e.index, e.generation };
+        for (Agent& a : agents) if (a.vehicle == h) return &a;
+        return nullptr;
+    }
+
+    // Vehicle timers that fired this tick, applied after everyone moved
+    void WakeAgents() {
+        VehicleStore& s = incident->vehicles;
+        for (const TimerEvent& e : woken) {
+            uint32_t i;
+            if (!s.Resolve(VehicleHandle{ e.index, e.generation }, i)) continue;
+            if (e.kind == TIMER_AMBULANCE) {
+                AmbulanceAgent* a = FindAgent(ambulances, e);
+                if (!a) continue;
+                if (a->state == WAIT_AT_ACCIDENT) {
+                    a->state = TO_HOSPITAL;
+                    if (Incident* acc = incidents.Get(a->incident)) acc->ambulanceLeft = true;
+                } else if (a->state == WAIT_AT_HOSPITAL) {
+                    a->state = LEAVING;
+                } else continue;
+                s.Set(i, VF_MOVING, true);
+            } else if (e.kind == TIMER_TOW) {
+                TowAgent* t = FindAgent(tows, e);
+                if (!t || !t->isWorking) continue;
+                t->hasPickedUp = true; t->isWorking = false; s.Set(i, VF_MOVING, true);
+            } else if (e.kind == TIMER_BUS) {
+                BusAgent* b = FindAgent(buses, e);
+                if (b && b->state == BUS_WAIT_AT_SCHOOL) b->state = BUS_LEAVING;
+            }
+        }
+        woken.clear();
+    }
+
+    // Stop decision for vehicle i, of kind Kind
+    template <class Kind> StopDecision DecideStop(const Carriageway& road, uint32_t i) const {
+        const VehicleStore& s = road.vehicles;
+        if (s.Has(i, VF_RECKLESS)) return STOP_NO;
+        if (Kind::STOPS_AT_LIGHTS) {
+            for (const TrafficLight& light : road.lights) {
+                if (light.IsRed() && fabs(s.x[i] - light.GetStopLineX(!road.dirRight)) < 50) return STOP_YES;
+            }
+        }
+        return MustStop<Kind>(road, i) || FlowBlocks<Kind>(road, i) ? STOP_YES : STOP_NO;
+    }
+
+    // Stop decisions for one chunk of a lane. Reads positions and flags of
+    // any vehicle but only writes stopDecision of its own, so chunks can run
+    // in parallel.
+    void DecideStops(const WorkRange& w) {
+        Carriageway& road = *w.road;
+        const VehicleStore& s = road.vehicles;
+        LaneView lane = road.lanes.Lane(w.lane);
+        for (uint32_t k = w.begin; k < w.end; k++) {
+            uint32_t i = lane[k];
+            if (s.Has(i, VF_CRASHED | VF_TOWED)) { road.stopDecision[i] = STOP_KEEP; continue; }
+            road.stopDecision[i] = ForKind(s.type[i], [&](auto kind) { return DecideStop<decltype(kind)>(road, i); });
+        }
+    }
+
+    // Dense pass over a range of one carriageway: applies the stop decisions
+    // and moves the plain cars. Special vehicles move in their own passes.
+    static void UpdateCars(const WorkRange& w, bool vector) {
+        Carriageway& road = *w.road;
+        StepCars(road.vehicles, road.stopDecision.data(), w.begin, w.end, vector);
+    }
+
+    void Apply(const Command& c) {
+        if (!Accepts(c.type, c.args)) return;
+        const CommandArgs& a = c.args;
+        switch (c.type) {
+            case CMD_CALL_AMBULANCE: CallAmbulance(); break;
+            case CMD_CALL_DEPANNAGE: CallDepannage(); break;
+            case CMD_TRIGGER_ACCIDENT: TriggerRandomAccident(); break;
+            case CMD_CALL_SCHOOL_BUS: CallSchoolBus(); break;
+            case CMD_SPAWN_CARS: SpawnCars(*roads[a.road], a.index, a.count); break;
+            case CMD_ACCIDENT_AT: TriggerAccidentAt(a.value); break;
+            case CMD_SET_SIGNAL_CYCLE: roads[a.road]->lights[a.index].SetCycle(a.value); break;
+            default: break;
+        }
+    }
+
+    // --- STEP PHASES ---
+    void ApplyCommands() {
+        PROFILE_SCOPE("sim.commands");
+        for (const Command& c : pending) {
+            if (recorder) recorder->Record(tick, c.type, c.args);
+            Apply(c);
+        }
+        pending.clear();
+    }
+
+    void SpawnAndSignals(float delta) {
+        PROFILE_SCOPE("sim.spawn");
+        for (const auto& road : roads) {
+            road->spawnTimer += delta; if (road->spawnTimer >= SpawnDelay()) { road->spawnTimer = 0.0f; SpawnCar(*road); }
+        }
+        if (rng.Int(0, 1000) < config.accidentPerMille) TriggerRandomAccident();
+        timers.Advance(tick, [this](const TimerEvent& e) {
+            if (e.kind != TIMER_SIGNAL) { woken.push_back(e); return; }
+            TrafficLight& light = roads[e.index]->lights[e.sub];
+            light.Toggle();
+            timers.Schedule(tick + light.CycleTicks(), e);
+        });
+    }
+
+    // Hands cars between the store and the flow lanes and steps the flow
+    // lanes. With level of detail off, any cars still in them come back.
+    void UpdateDetail() {
+        PROFILE_SCOPE("sim.lod");
+        if (!lod && FlowCount() == 0) return;
+        for (const auto& road : roads) {
+            if (lod) BuildDetailSpans(*road); else road->detail.clear();
+            DemoteOutside(*road);
+            StepFlow(*road);
+        }
+    }
+
+    // Turns pending accidents into crashes once their two cars touch, and
+    // closes incidents whose vehicles have left the map: the cars before
+    // the tow truck hooks them, the tow truck afterwards
+    void ResolveIncidents() {
+        PROFILE_SCOPE("sim.accident");
+        VehicleStore& s = incident->vehicles;
+        for (uint32_t slot = 0; slot < incidents.SlotCount(); slot++) {
+            if (!incidents.IsLive(slot)) continue;
+            Incident& acc = incidents.At(slot);
+            IncidentHandle handle = incidents.HandleAt(slot);
+            uint32_t car1 = 0, car2 = 0, tow = 0;
+            if (acc.state == INCIDENT_CLEARING) {
+                if (s.Resolve(acc.tow, tow)) continue;
+                if (metrics) metrics->clearance.Add(tick - acc.crashTick);
+                incidents.Close(handle);
+                continue;
+            }
+            if (!s.Resolve(acc.car1, car1) || !s.Resolve(acc.car2, car2)) { incidents.Close(handle); continue; }
+            if (acc.state != INCIDENT_PENDING) continue;
+            float dist = s.x[car2] - s.x[car1];
+            if (dist < VEHICLE_WIDTH - 10.0f && dist > -VEHICLE_WIDTH) {
+                acc.state = INCIDENT_ACTIVE;
+                s.Set(car1, VF_CRASHED, true); s.Set(car2, VF_CRASHED, true);
+                s.Set(car2, VF_RECKLESS, false); s.Set(car1, VF_MOVING, false); s.Set(car2, VF_MOVING, false);
+                acc.x = s.x[car1] + (VEHICLE_WIDTH/2); acc.y = s.y[car1];
+                acc.crashTick = tick;
+                ambulanceQueue.Push(handle);
+                towQueue.Push(handle);
+                stats.accidents++;
+            }
+        }
+    }
+
+    // Hands the oldest crashes waiting for an ambulance to the ambulances
+    // that are patrolling, in the order both were called
+    void Dispatch() {
+        PROFILE_SCOPE("sim.dispatch");
+        VehicleStore& s = incident->vehicles;
+        for (AmbulanceAgent& a : ambulances) {
+            if (a.state != PATROL) continue;
+            IncidentHandle target;
+            if (!ambulanceQueue.Pop(incidents, target)) break;
+            Incident& acc = *incidents.Get(target);
+            uint32_t i;
+            if (s.Resolve(a.vehicle, i)) s.targetY[i] = acc.y;
+            a.incident = target; a.accidentX = acc.x; a.accidentY = acc.y; a.state = TO_ACCIDENT;
+            a.crashTick = acc.crashTick;
+            acc.ambulance = a.vehicle;
+        }
+    }
+
+    // Hooks the wrecks onto each tow truck once it has picked them up, then
+    // drags every towed vehicle along behind its tower
+    void UpdateTowing() {
+        PROFILE_SCOPE("sim.tow");
+        VehicleStore& s = incident->vehicles;
+        for (const TowAgent& t : tows) {
+            Incident* acc = incidents.Get(t.incident);
+            uint32_t towIdx = 0, c = 0;
+            if (!t.hasPickedUp || !acc || acc->state != INCIDENT_ACTIVE || !s.Resolve(t.vehicle, towIdx)) continue;
+            if (s.Resolve(acc->car1, c)) { s.Set(c, VF_TOWED, true); s.Set(c, VF_CRASHED | VF_ACCIDENT_TARGET, false); s.towOffsetX[c] = 100.0f; s.tower[c] = t.vehicle; s.y[c] = s.y[towIdx]; }
+            if (s.Resolve(acc->car2, c)) { s.Set(c, VF_TOWED, true); s.Set(c, VF_CRASHED, false); s.towOffsetX[c] = 200.0f; s.tower[c] = t.vehicle; s.y[c] = s.y[towIdx]; }
+            acc->state = INCIDENT_CLEARING;
+        }
+        for (uint32_t i = 0; i < s.Size(); i++) {
+            uint32_t t;
+            if (s.Has(i, VF_TOWED) && s.Resolve(s.tower[i], t)) { s.x[i] = s.x[t] + s.towOffsetX[i]; s.y[i] = s.y[t]; }
+        }
+    }
+
+    // Brings the lane index up to date with this tick's lane targets and positions
+    void UpdateLanes() {
+        PROFILE_SCOPE("sim.lanes");
+        VehicleStore& s = incident->vehicles;
+        for (const AmbulanceAgent& amb : ambulances) {
+            uint32_t a;
+            if (!s.Resolve(amb.vehicle, a)) continue;
+            const Incident* acc = incidents.Get(amb.incident);
+            if (amb.state == TO_HOSPITAL) s.targetY[a] = incident->laneY[LastLane()];
+            else if (amb.state == TO_ACCIDENT && acc && acc->state == INCIDENT_ACTIVE) s.targetY[a] = acc->y;
+        }
+        for (uint32_t i = 0; i < s.Size(); i++) incident->lanes.Relane(i);
+        BuildLaneWork(laneWork, UINT32_MAX);
+        // Empty lanes get no task, and so no refresh
+        for (int lane = 0; lane < incident->LaneCount(); lane++) {
+            if (incident->lanes.Lane(lane).Empty()) { candidates[lane].clear(); closestCandidate[lane] = -1; }
+        }
+        RunParallel((uint32_t)laneWork.size(), [this](uint32_t k) {
+            const WorkRange& w = laneWork[k];
+            w.road->lanes.ResortLane(w.lane);
+            if (w.road == incident) RefreshCandidates(w.lane);
+        });
+    }
+
+    // Lane changes are collected per lane from the same snapshot, then
+    // merged serially in lane order, so scheduling cannot change them
+    void UpdateSwerves() {
+        PROFILE_SCOPE("sim.swerve");
+        yieldFor.clear();
+        for (const AmbulanceAgent& a : ambulances) yieldFor.push_back(a.vehicle);
+        for (const TowAgent& t : tows) if (t.isWorking) yieldFor.push_back(t.vehicle);
+        RunParallel((uint32_t)swerves.size(), [this](uint32_t lane) {
+            swerves[lane].clear();
+            for (VehicleHandle h : yieldFor) CollectYields((int)lane, h, swerves[lane]);
+            swerveYields[lane] = (uint32_t)swerves[lane].size();
+            CollectAvoiders((int)lane, swerves[lane]);
+        });
+        for (size_t lane = 0; lane < swerves.size(); lane++) {
+            for (size_t k = 0; k < swerves[lane].size(); k++) {
+                uint32_t v = swerves[lane][k];
+                if (!CanSwerve(v)) continue;
+                Swerve(v);
+                if (k < swerveYields[lane]) stats.yields++;
+            }
+        }
+    }
+
+    // Decides who has to stop, from this tick's positions, before anyone moves
+    void DecideAll() {
+        PROFILE_SCOPE("sim.decide");
+        for (const auto& road : roads) road->stopDecision.resize(road->vehicles.Size());
+        BuildLaneWork(decideWork, TASK_CHUNK);
+        RunParallel((uint32_t)decideWork.size(), [this](uint32_t k) { DecideStops(decideWork[k]); });
+    }
+
+    void MoveAll() {
+        PROFILE_SCOPE("sim.move");
+        BuildDenseWork(moveWork, TASK_CHUNK);
+        RunParallel((uint32_t)moveWork.size(), [this](uint32_t k) { UpdateCars(moveWork[k], simd); });
+        UpdateAmbulances();
+        UpdateTows();
+        UpdateBuses();
+        WakeAgents();
+    }
+
+    // Advances the model by exactly one fixed tick
+    void Step() {
+        PROFILE_SCOPE("sim.step");
+        const float delta = TICK_DT;
+        for (const auto& road : roads) road->vehicles.SavePrevious();
+
+        ApplyCommands();
+        SpawnAndSignals(delta);
+        Despawn();
+        UpdateDetail();
+        ResolveIncidents();
+        Dispatch();
+
+        UpdateTowing();
+        UpdateLanes();
+        UpdateSwerves();
+        DecideAll();
+        MoveAll();
+
+        stats.ticks++; stats.simTime += delta;
+        tick++;
+    }
+
+    // Writes the full model state, RNG included, as a framed snapshot. A
+    // Simulation built from the same WorldConfig that loads it carries on
+    // exactly as this one would. Not const because Transfer is shared with
+    // loading; writing leaves the state untouched.
+    void SaveSnapshot(std::vector<uint8_t>& out) {
+        PROFILE_SCOPE("sim.snapshot");
+        std::vector<uint8_t> payload;
+        SnapshotWriter w(payload);
+        Transfer(w);
+        FrameSnapshot(out, config.Fingerprint(), payload);
+    }
+
+    // On failure the simulation is left half loaded and must be discarded
+    bool LoadSnapshot(const std::vector<uint8_t>& data, std::string& error) {
+        PROFILE_SCOPE("sim.snapshot");
+        const uint8_t* payload;
+        size_t size;
+        if (!UnframeSnapshot(data, config.Fingerprint(), payload, size, error)) return false;
+        SnapshotReader r(payload, size);
+        Transfer(r);
+        r.Check(r.AtEnd(), "snapshot has trailing data");
+        if (!r.Ok()) { error = r.Error(); return false; }
+        return true;
+    }
+
+    bool SaveSnapshotFile(const char* path) {
+        std::vector<uint8_t> data;
+        SaveSnapshot(data);
+        return WriteSnapshotFile(path, data);
+    }
+
+    bool LoadSnapshotFile(const char* path, std::string& error) {
+        std::vector<uint8_t> data;
+        if (!ReadSnapshotFile(path, data)) { error = std::string(path) + ": cannot read the file"; return false; }
+        if (!LoadSnapshot(data, error)) { error = std::string(path) + ": " + error; return false; }
+        return true;
+    }
+
+    // FNV-1a over the full model state; equal hashes mean identical runs
+    uint64_t StateHash() const {
+        uint64_t h = 1469598103934665603ULL;
+        auto mix = [&](const void* data, size_t n) {
+            const unsigned char* p = (const unsigned char*)data;
+            for (size_t k = 0; k < n; k++) { h ^= p[k]; h *= 1099511628211ULL; }
+        };
+        auto mixColumn = [&](const auto& column) { if (!column.empty()) mix(column.data(), column.size() * sizeof(column[0])); };
+        for (const auto& road : roads) {
+            const VehicleStore& s = road->vehicles;
+            mixColumn(s.x); mixColumn(s.y); mixColumn(s.targetY); mixColumn(s.speed); mixColumn(s.flags); mixColumn(s.type);
+            for (const TrafficLight& light : road->lights) { bool red = light.IsRed(); mix(&red, sizeof(red)); }
+            for (int lane = 0; lane < road->flow.LaneCount(); lane++) mixColumn(road->flow.Lane(lane));
+        }
+        for (const AmbulanceAgent& a : ambulances) { mix(&a.state, sizeof(a.state)); mix(&a.wakeTick, sizeof(a.wakeTick)); }
+        for (const TowAgent& t : tows) { mix(&t.wakeTick, sizeof(t.wakeTick)); mix(&t.hasPickedUp, sizeof(t.hasPickedUp)); }
+        for (const BusAgent& b : buses) { mix(&b.state, sizeof(b.state)); mix(&b.wakeTick, sizeof(b.wakeTick)); }
+        for (uint32_t slot = 0; slot < incidents.SlotCount(); slot++) {
+            if (!incidents.IsLive(slot)) continue;
+            const Incident& acc = incidents.At(slot);
+            mix(&slot, sizeof(slot)); mix(&acc.state, sizeof(acc.state)); mix(&acc.x, sizeof(float)); mix(&acc.y, sizeof(float));
+        }
+        for (const auto& road : roads) mix(&road->spawnTimer, sizeof(float));
+        uint64_t rs = rng.GetState(); mix(&rs, sizeof(rs));
+        mix(&tick, sizeof(tick));
+        return h;
+    }
+
+    const WorldConfig& GetConfig() const { return config; }
+    int RoadCount() const { return (int)roads.size(); }
+    const Carriageway& GetRoad(int k) const { return *roads[k]; }
+    const Carriageway& GetIncidentRoad() const { return *incident; }
+    const IncidentTable& GetIncidents() const { return incidents; }
+    // Accident candidates in one incident-road lane, as of the last lane re-sort
+    const std::vector<GapPair>& GetAccidentCandidates(int lane) const { return candidates[lane]; }
+    // The candidate pair with the smallest gap in one lane; false if it has none
+    bool ClosestGap(int lane, GapPair& out) const {
+        if (closestCandidate[lane] < 0) return false;
+        out = candidates[lane][closestCandidate[lane]];
+        return true;
+    }
+    // Position of an incident-road vehicle, false if it has despawned
+    bool GetVehiclePosition(VehicleHandle h, float& x, float& y) const {
+        uint32_t i;
+        if (!incident->vehicles.Resolve(h, i)) return false;
+        x = incident->vehicles.x[i]; y = incident->vehicles.y[i];
+        return true;
+    }
+    bool IsAmbulanceActive() const { return !ambulances.empty(); }
+    size_t AmbulanceCount() const { return ambulances.size(); }
+
+    // Vehicles standing in one light's approach within QUEUE_REACH of its
+    // stop line: stopped by the light or by the queue in front of them
+    size_t QueueAt(int road, int light) const {
+        const Carriageway& r = *roads[road];
+        const VehicleStore& s = r.vehicles;
+        float line = r.lights[light].GetStopLineX(!r.dirRight);
+        size_t n = 0;
+        for (uint32_t i = 0; i < s.Size(); i++) {
+            if (!s.Has(i, VF_FORCED_STOP) || s.Has(i, VF_CRASHED | VF_TOWED)) continue;
+            float behind = r.dirRight ? line - s.x[i] : s.x[i] - line;
+            if (behind >= -VEHICLE_WIDTH && behind <= QUEUE_REACH) n++;
+        }
+        return n;
+    }
+
+    // Crashes still waiting for an ambulance beyond those already patrolling
+    int AmbulancesNeeded() const {
+        int waiting = 0, idle = 0;
+        ambulanceQueue.ForEachOpen(incidents, [&](IncidentHandle) { waiting++; return true; });
+        for (const AmbulanceAgent& a : ambulances) if (a.state == PATROL) idle++;
+        return std::max(0, waiting - idle);
+    }
+    // Crashes at the front of the tow queue whose ambulance has already left
+    int TowsReady() const {
+        int ready = 0;
+        towQueue.ForEachOpen(incidents, [&](IncidentHandle h) {
+            if (!incidents.Get(h)->ambulanceLeft) return false;
+            ready++;
+            return true;
+        });
+        return ready;
+    }
+    // Vehicles in the stores, the ones a front end draws
+    size_t VehicleCount() const {
+        size_t n = 0;
+        for (const auto& road : roads) n += road->vehicles.Size();
+        return n;
+    }
+    // Cars queued in the flow lanes, outside every detail span
+    size_t FlowCount() const {
+        size_t n = 0;
+        for (const auto& road : roads) n += road->flow.Count();
+        return n;
+    }
+    const SimStats& GetStats() const { return stats; }
+    PoolStats GetPoolStats() const {
+        PoolStats p;
+        for (const auto& road : roads) {
+            p.capacity += road->vehicles.Capacity();
+            p.live += road->vehicles.Size();
+            p.highWater += road->vehicles.HighWater();
+        }
+        return p;
+    }
+};
@@ -0,0 +1,178 @@
+#pragma once
+// Binary checkpoints of the whole model. Every stateful class has a
+// Transfer(ar) member that names its fields once; SnapshotWriter appends
+// them to a byte buffer and SnapshotReader reads them back in the same
+// order, so saving and loading cannot drift apart.
+//
+// Snapshot layout (little endian):
+//   "TRSS" | u32 version | u64 config fingerprint | u64 payload size | payload | u64 payload hash
+//
+// The payload is only meaningful to a Simulation built from the same
+// WorldConfig, which the fingerprint checks. The hash catches truncated
+// or damaged files before anything is read out of them.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+constexpr uint32_t SNAPSHOT_VERSION = 5;
+constexpr size_t SNAPSHOT_HEADER_SIZE = 4 + 4 + 8 + 8;
+
+inline uint64_t SnapshotHash(const uint8_t* data, size_t n) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t k = 0; k < n; k++) { h ^= data[k]; h *= 1099511628211ULL; }
+    return h;
+}
+
+class SnapshotWriter {
+private:
+    std::vector<uint8_t>& out;
+
+public:
+    static constexpr bool LOADING = false;
+
+    explicit SnapshotWriter(std::vector<uint8_t>& buffer) : out(buffer) {}
+
+    template <class T> void Value(const T& v) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot values must be plain data");
+        size_t at = out.size();
+        out.resize(at + sizeof(T));
+        memcpy(&out[at], &v, sizeof(T));
+    }
+
+    // Element type must have no padding; the bytes go out as they are
+    template <class T> void Array(const std::vector<T>& v, uint32_t = UINT32_MAX) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot arrays must be plain data");
+        uint32_t n = (uint32_t)v.size();
+        Value(n);
+        size_t at = out.size();
+        out.resize(at + sizeof(T) * n);
+        if (n) memcpy(&out[at], v.data(), sizeof(T) * n);
+    }
+
+    // Count, then each(element) for every element
+    template <class T, class F> void Records(std::vector<T>& v, uint32_t, F each) {
+        uint32_t n = (uint32_t)v.size();
+        Value(n);
+        for (T& item : v) each(item);
+    }
+
+    bool Ok() const { return true; }
+    void Check(bool, const char*) {}
+};
+
+class SnapshotReader {
+private:
+    const uint8_t* p;
+    size_t left;
+    std::string error;
+
+public:
+    static constexpr bool LOADING = true;
+
+    SnapshotReader(const uint8_t* data, size_t n) : p(data), left(n) {}
+
+    bool Ok() const { return error.empty(); }
+    const std::string& Error() const { return error; }
+    bool AtEnd() const { return left == 0; }
+
+    void Check(bool condition, const char* what) {
+        if (!condition && error.empty()) error = what;
+    }
+
+    template <class T> void Value(T& v) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot values must be plain data");
+        if (!Ok()) return;
+        if (left < sizeof(T)) { Check(false, "snapshot ends early"); return; }
+        memcpy(&v, p, sizeof(T));
+        p += sizeof(T); left -= sizeof(T);
+    }
+
+    // Refuses more than limit elements; a vector that already has the
+    // room keeps its storage
+    template <class T> void Array(std::vector<T>& v, uint32_t limit = UINT32_MAX) {
+        uint32_t n = 0;
+        Value(n);
+        if (!Ok()) return;
+        if (n > limit) { Check(false, "snapshot holds more entries than this world has room for"); return; }
+        if ((size_t)n * sizeof(T) > left) { Check(false, "snapshot ends early"); return; }
+        v.resize(n);
+        if (n) memcpy(v.data(), p, sizeof(T) * n);
+        p += sizeof(T) * n; left -= sizeof(T) * n;
+    }
+
+    // Records are plain values of fixed size, so the bytes the first one
+    // took say how many the rest need; a short payload is refused before
+    // the vector grows to the count it claims
+    template <class T, class F> void Records(std::vector<T>& v, uint32_t limit, F each) {
+        uint32_t n = 0;
+        Value(n);
+        if (!Ok()) return;
+        if (n > limit) { Check(false, "snapshot holds more entries than this world has room for"); return; }
+        if (n == 0) { v.clear(); return; }
+        T first{};
+        size_t before = left;
+        each(first);
+        if (!Ok()) return;
+        if ((size_t)(n - 1) * (before - left) > left) { Check(false, "snapshot ends early"); return; }
+        v.resize(n);
+        v[0] = first;
+        for (uint32_t k = 1; k < n; k++) each(v[k]);
+    }
+};
+
+// Wraps a payload in the snapshot header and trailing hash
+inline void FrameSnapshot(std::vector<uint8_t>& out, uint64_t fingerprint, const std::vector<uint8_t>& payload) {
+    const char magic[4] = { 'T', 'R', 'S', 'S' };
+    out.clear();
+    out.reserve(SNAPSHOT_HEADER_SIZE + payload.size() + 8);
+    SnapshotWriter w(out);
+    w.Value(magic);
+    w.Value(SNAPSHOT_VERSION);
+    w.Value(fingerprint);
+    w.Value((uint64_t)payload.size());
+    out.insert(out.end(), payload.begin(), payload.end());
+    w.Value(SnapshotHash(payload.data(), payload.size()));
+}
+
+// Checks the header and hash; on success payload/payloadSize point into data
+inline bool UnframeSnapshot(const std::vector<uint8_t>& data, uint64_t fingerprint, const uint8_t*& payload, size_t& payloadSize, std::string& error) {
+    SnapshotReader r(data.data(), data.size());
+    char magic[4] = { 0 };
+    uint32_t version = 0;
+    uint64_t fp = 0, size = 0;
+    r.Value(magic); r.Value(version); r.Value(fp); r.Value(size);
+    if (!r.Ok() || memcmp(magic, "TRSS", 4) != 0) { error = "not a snapshot"; return false; }
+    if (version != SNAPSHOT_VERSION) { error = "unsupported snapshot version " + std::to_string(version); return false; }
+    if (fp != fingerprint) { error = "snapshot was taken with a different world configuration"; return false; }
+    if (size + 8 != data.size() - SNAPSHOT_HEADER_SIZE) { error = "snapshot is truncated"; return false; }
+    payload = data.data() + SNAPSHOT_HEADER_SIZE;
+    payloadSize = (size_t)size;
+    uint64_t hash;
+    memcpy(&hash, payload + payloadSize, sizeof(hash));
+    if (hash != SnapshotHash(payload, payloadSize)) { error = "snapshot is damaged"; return false; }
+    return true;
+}
+
+inline bool WriteSnapshotFile(const char* path, const std::vector<uint8_t>& data) {
+    FILE* f = fopen(path, "wb");
+    if (!f) return false;
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    if (fclose(f) != 0) ok = false;
+    return ok;
+}
+
+inline bool ReadSnapshotFile(const char* path, std::vector<uint8_t>& data) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    data.clear();
+    uint8_t buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+    bool ok = ferror(f) == 0;
+    fclose(f);
+    return ok;
+}
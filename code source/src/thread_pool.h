@@ -0,0 +1,144 @@
+#pragma once
+// Small work-stealing pool for data-parallel phases of the simulation.
+// Run(count, fn) calls fn(0) .. fn(count - 1) exactly once each and returns
+// when all calls are done. Task indices are dealt round-robin into one
+// queue per participant; each participant pops from the back of its own
+// queue and, once empty, steals from the front of the others. The calling
+// thread takes part as participant 0, so a pool of size 1 has no threads.
+// The queues keep their storage between jobs and fn is passed by
+// reference, not wrapped in a std::function, so a steady stream of
+// same-sized jobs runs without touching the heap.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+private:
+    // Tasks live in [head, tasks.size()): the owner pops the back, thieves take the front
+    struct Queue {
+        std::mutex mutex;
+        std::vector<uint32_t> tasks;
+        size_t head = 0;
+        bool Empty() const { return head == tasks.size(); }
+    };
+
+    // The current job, type-erased without allocating
+    struct Job {
+        void (*call)(const void* fn, uint32_t task);
+        const void* fn;
+        void operator()(uint32_t task) const { call(fn, task); }
+    };
+
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<Queue>> queues;
+
+    std::mutex jobMutex;
+    std::condition_variable jobReady, jobDone;
+    Job job = { nullptr, nullptr };
+    uint64_t jobGeneration = 0;
+    std::atomic<uint32_t> remaining{ 0 };
+    int busyWorkers = 0;
+    bool stopping = false;
+
+    bool PopOrSteal(size_t self, uint32_t& task) {
+        {
+            Queue& own = *queues[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.Empty()) { task = own.tasks.back(); own.tasks.pop_back(); return true; }
+        }
+        for (size_t k = 1; k < queues.size(); k++) {
+            Queue& victim = *queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.Empty()) { task = victim.tasks[victim.head++]; return true; }
+        }
+        return false;
+    }
+
+    void RunTasks(size_t self, const Job& fn) {
+        uint32_t task;
+        while (PopOrSteal(self, task)) {
+            fn(task);
+            remaining.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+
+    void WorkerLoop(size_t self) {
+        uint64_t seen = 0;
+        for (;;) {
+            Job fn;
+            {
+                std::unique_lock<std::mutex> lock(jobMutex);
+                jobReady.wait(lock, [&] { return stopping || jobGeneration != seen; });
+                if (stopping) return;
+                seen = jobGeneration;
+                fn = job;
+                busyWorkers++;
+            }
+            if (fn.call) RunTasks(self, fn);
+            {
+                std::lock_guard<std::mutex> lock(jobMutex);
+                if (--busyWorkers == 0) jobDone.notify_all();
+            }
+        }
+    }
+
+public:
+    // participants counts the calling thread; 0 means one per hardware thread
+    explicit ThreadPool(unsigned participants = 0) {
+        if (participants == 0) participants = std::thread::hardware_concurrency();
+        if (participants == 0) participants = 1;
+        for (unsigned i = 0; i < participants; i++) queues.push_back(std::make_unique<Queue>());
+        for (unsigned i = 1; i < participants; i++) threads.emplace_back(&ThreadPool::WorkerLoop, this, (size_t)i);
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            stopping = true;
+        }
+        jobReady.notify_all();
+        for (std::thread& t : threads) t.join();
+    }
+
+    size_t Size() const { return queues.size(); }
+
+    template <class F> void Run(uint32_t count, const F& fn) {
+        if (count == 0) return;
+        if (queues.size() == 1 || count == 1) {
+            for (uint32_t k = 0; k < count; k++) fn(k);
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(jobMutex);
+        // A worker that woke up late for the previous job must be done
+        // before new tasks go in, or it could run them with a stale job
+        jobDone.wait(lock, [&] { return busyWorkers == 0; });
+        for (size_t q = 0; q < queues.size(); q++) {
+            Queue& queue = *queues[q];
+            std::lock_guard<std::mutex> qlock(queue.mutex);
+            queue.tasks.clear();
+            queue.head = 0;
+            for (uint32_t k = (uint32_t)q; k < count; k += (uint32_t)queues.size()) queue.tasks.push_back(k);
+        }
+        remaining.store(count, std::memory_order_release);
+        Job current = { [](const void* f, uint32_t task) { (*static_cast<const F*>(f))(task); }, &fn };
+        job = current;
+        jobGeneration++;
+        lock.unlock();
+        jobReady.notify_all();
+
+        RunTasks(0, current);
+
+        lock.lock();
+        jobDone.wait(lock, [&] { return remaining.load(std::memory_order_acquire) == 0 && busyWorkers == 0; });
+        job = Job{ nullptr, nullptr };
+    }
+};
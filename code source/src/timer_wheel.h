@@ -0,0 +1,139 @@
+#pragma once
+// Hierarchical timer wheel over simulation ticks. State machines that only
+// wait (a light between changes, an ambulance at the crash, a tow truck at
+// work, a bus at the school) schedule the tick they next change on and are
+// not looked at again until then. Advance() costs one slot per tick plus
+// the timers that fire, whatever the number of sleepers.
+//
+// Four levels of 64 slots cover 2^24 ticks (about 77 hours at 60 ticks a
+// second); anything further out waits in the top level and is cascaded
+// down again as the wheel turns. Timers in one slot fire in the order they
+// were scheduled, so runs stay reproducible.
+//
+// The wheel only knows ticks. Pausing or speeding up the simulation means
+// stepping it less or more often, which moves every timer and every
+// vehicle together.
+
+#include <cstdint>
+#include <vector>
+
+// What to do when a timer fires; `index` and `sub` are the owner's to interpret
+struct TimerEvent {
+    uint32_t kind;
+    uint32_t index;
+    uint32_t sub;
+    uint32_t generation;
+};
+
+class TimerWheel {
+private:
+    static constexpr int LEVELS = 4;
+    static constexpr int SLOT_BITS = 6;
+    static constexpr uint32_t SLOTS = 1u << SLOT_BITS;
+    static constexpr uint32_t SLOT_MASK = SLOTS - 1;
+    static constexpr int32_t NONE = -1;
+
+    struct Entry {
+        uint32_t due;
+        int32_t next;
+        TimerEvent event;
+    };
+    struct Slot {
+        int32_t head = NONE, tail = NONE;
+    };
+
+    std::vector<Entry> entries;
+    std::vector<int32_t> freeEntries;
+    std::vector<Slot> slots;               // LEVELS * SLOTS, level 0 first
+    uint32_t next = 0;                     // first tick not yet advanced through
+    uint32_t pending = 0;
+
+    void Link(int32_t e) {
+        uint32_t due = entries[e].due;
+        uint32_t delta = due - next;
+        int level = 0;
+        while (level < LEVELS - 1 && delta >= (1u << (SLOT_BITS * (level + 1)))) level++;
+        Slot& slot = slots[level * SLOTS + ((due >> (SLOT_BITS * level)) & SLOT_MASK)];
+        entries[e].next = NONE;
+        if (slot.tail == NONE) slot.head = e; else entries[slot.tail].next = e;
+        slot.tail = e;
+    }
+
+    // Re-files every timer of one slot against the current tick
+    void Cascade(int level, uint32_t index) {
+        Slot& slot = slots[level * SLOTS + index];
+        int32_t e = slot.head;
+        slot.head = slot.tail = NONE;
+        while (e != NONE) {
+            int32_t following = entries[e].next;
+            Link(e);
+            e = following;
+        }
+    }
+
+public:
+    TimerWheel() : slots(LEVELS * SLOTS) {}
+
+    // Room for n timers at once, so scheduling never allocates
+    void Reserve(size_t n) { entries.reserve(n); freeEntries.reserve(n); }
+
+    uint32_t Pending() const { return pending; }
+
+    // Fires on the first Advance that reaches `due`; a tick already passed
+    // means the next one
+    void Schedule(uint32_t due, const TimerEvent& event) {
+        if ((int32_t)(due - next) < 0) due = next;
+        int32_t e;
+        if (!freeEntries.empty()) { e = freeEntries.back(); freeEntries.pop_back(); }
+        else { e = (int32_t)entries.size(); entries.emplace_back(); }
+        entries[e].due = due;
+        entries[e].event = event;
+        Link(e);
+        pending++;
+    }
+
+    // Moves the wheel through every tick up to and including `tick`,
+    // calling fire(event) for each timer due on the way
+    template <class F> void Advance(uint32_t tick, F fire) {
+        while ((int32_t)(tick - next) >= 0) {
+            uint32_t now = next;
+            // Higher levels first, so a timer can drop through several at once
+            for (int level = LEVELS - 1; level > 0; level--) {
+                uint32_t below = now & ((1u << (SLOT_BITS * level)) - 1);
+                if (below == 0) Cascade(level, (now >> (SLOT_BITS * level)) & SLOT_MASK);
+            }
+            Slot& slot = slots[now & SLOT_MASK];
+            int32_t e = slot.head;
+            slot.head = slot.tail = NONE;
+            next = now + 1;
+            while (e != NONE) {
+                int32_t following = entries[e].next;
+                if (entries[e].due == now) {
+                    TimerEvent event = entries[e].event;
+                    freeEntries.push_back(e);
+                    pending--;
+                    fire(event);
+                } else {
+                    Link(e);
+                }
+                e = following;
+            }
+        }
+    }
+
+    template <class A> void Transfer(A& ar) {
+        ar.Records(entries, UINT32_MAX, [&](Entry& entry) {
+            ar.Value(entry.due); ar.Value(entry.next);
+            ar.Value(entry.event.kind); ar.Value(entry.event.index); ar.Value(entry.event.sub); ar.Value(entry.event.generation);
+        });
+        ar.Array(freeEntries);
+        ar.Records(slots, LEVELS * SLOTS, [&](Slot& slot) { ar.Value(slot.head); ar.Value(slot.tail); });
+        ar.Value(next);
+        ar.Value(pending);
+        if (!A::LOADING) return;
+        bool ok = slots.size() == LEVELS * SLOTS && pending + freeEntries.size() == entries.size();
+        for (const Slot& slot : slots) ok = ok && slot.head >= NONE && slot.head < (int32_t)entries.size() && slot.tail >= NONE && slot.tail < (int32_t)entries.size();
+        for (const Entry& entry : entries) ok = ok && entry.next >= NONE && entry.next < (int32_t)entries.size();
+        ar.Check(ok, "snapshot timer wheel does not agree");
+    }
+};
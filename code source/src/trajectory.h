@@ -0,0 +1,466 @@
+#pragma once
+// Trajectory recording for offline analysis and playback. A recorder
+// captures every vehicle, light change and incident change after each
+// tick and hands finished chunks to a background thread that appends them
+// to disk, so the simulation never waits on I/O. TrajectoryFile maps a
+// recording into memory and gives random access to any frame without
+// re-simulating.
+//
+// File layout (little endian, every record 4-byte aligned):
+//   TrajectoryFileHeader
+//   roadCount  x TrajectoryRoad
+//   lightCount x TrajectoryLight
+//   chunks, each:
+//     TrajectoryChunkHeader
+//     lightCount x u8 red, padded to 4     light states before the first frame
+//     incidentCount x TrajectoryIncident   live incidents before the first frame
+//     frameCount x { TrajectoryFrameHeader, vehicles, events }
+//
+// A chunk is self-contained: the state of the lights and incidents at any
+// frame is its chunk's keyframe plus the events of the frames up to it. A
+// run that dies mid-write leaves a truncated last chunk, which the reader
+// ignores.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mapped_file.h"
+#include "simulation.h"
+
+struct TrajectoryFileHeader {
+    char magic[4];                 // "TRTJ"
+    uint32_t version;
+    uint64_t seed;
+    float worldWidth;
+    uint32_t roadCount;
+    uint32_t lightCount;
+    uint32_t reserved;
+};
+
+struct TrajectoryRoad {
+    float y;
+    uint8_t lanes, dirRight, incidents, reserved;
+};
+
+struct TrajectoryLight {
+    float x, y;
+    uint16_t road, reserved;
+};
+
+struct TrajectoryChunkHeader {
+    char magic[4];                 // "CHNK"
+    uint32_t byteSize;             // whole chunk, this header included
+    uint32_t frameCount;
+    uint32_t incidentCount;
+};
+
+struct TrajectoryFrameHeader {
+    uint32_t tick;
+    uint32_t vehicleCount;
+    uint32_t eventCount;
+    uint32_t reserved;
+};
+
+// One vehicle after a tick. (road, slot, generation) identifies it for its
+// whole life; slots are reused once the generation moves on.
+struct TrajectoryVehicle {
+    uint32_t slot, generation;
+    float x, y, speed;
+    Tint color;
+    uint16_t flags;                // VehicleFlag bits
+    uint8_t type, road, sprite, reserved[3];
+};
+
+struct TrajectoryIncident {
+    uint32_t slot;
+    uint8_t state, reserved[3];
+    float x, y;
+};
+
+enum TrajectoryEventKind : uint8_t {
+    TRAJ_EVENT_SIGNAL,             // index: light, id: 1 if it turned red
+    TRAJ_EVENT_INCIDENT,           // id: incident slot, index: its new IncidentState
+    TRAJ_EVENT_INCIDENT_CLOSED     // id: incident slot
+};
+
+struct TrajectoryEvent {
+    uint8_t kind, road;
+    uint16_t index;
+    uint32_t id;
+    float x, y;
+};
+
+static_assert(sizeof(TrajectoryFileHeader) == 32, "trajectory header layout");
+static_assert(sizeof(TrajectoryVehicle) == 32, "trajectory vehicle layout");
+static_assert(sizeof(TrajectoryEvent) == 16, "trajectory event layout");
+static_assert(sizeof(TrajectoryIncident) == 16, "trajectory incident layout");
+
+constexpr uint32_t TRAJECTORY_VERSION = 1;
+
+// --- WRITER ---
+// Appends buffers to a file on its own thread. Write() swaps the caller's
+// buffer for an empty one from a spare list, so once a few chunks have
+// gone round the recorder reuses the same storage.
+class TrajectoryWriter {
+private:
+    FILE* file = nullptr;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::vector<std::vector<uint8_t>> queue, spare;
+    bool stopping = false;
+    std::atomic<bool> failed{ false };
+    std::atomic<unsigned long long> bytesWritten{ 0 };
+
+    void Loop() {
+        std::vector<std::vector<uint8_t>> writing;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            ready.wait(lock, [&] { return stopping || !queue.empty(); });
+            if (queue.empty()) return;
+            writing.swap(queue);
+            lock.unlock();
+            for (std::vector<uint8_t>& b : writing) {
+                if (!failed && fwrite(b.data(), 1, b.size(), file) != b.size()) failed = true;
+                bytesWritten += b.size();
+                b.clear();
+            }
+            lock.lock();
+            for (std::vector<uint8_t>& b : writing) spare.push_back(std::move(b));
+            writing.clear();
+        }
+    }
+
+public:
+    TrajectoryWriter() = default;
+    TrajectoryWriter(const TrajectoryWriter&) = delete;
+    TrajectoryWriter& operator=(const TrajectoryWriter&) = delete;
+    ~TrajectoryWriter() { Close(); }
+
+    bool Open(const char* path) {
+        file = fopen(path, "wb");
+        if (!file) return false;
+        stopping = false;
+        failed = false;
+        thread = std::thread(&TrajectoryWriter::Loop, this);
+        return true;
+    }
+
+    bool IsOpen() const { return file != nullptr; }
+
+    // Queues buffer for writing and leaves an empty one in its place
+    void Write(std::vector<uint8_t>& buffer) {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(buffer));
+        buffer.clear();
+        if (!spare.empty()) { buffer.swap(spare.back()); spare.pop_back(); }
+        ready.notify_one();
+    }
+
+    // Waits for everything queued to reach the file; false on any write error
+    bool Close() {
+        if (!file) return true;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        ready.notify_one();
+        thread.join();
+        if (fclose(file) != 0) failed = true;
+        file = nullptr;
+        return !failed;
+    }
+
+    unsigned long long BytesWritten() const { return bytesWritten; }
+};
+
+// --- RECORDER ---
+// Call Capture() after every Step(). Frames are collected into chunks of
+// FRAMES_PER_CHUNK ticks; only whole chunks cross over to the writer.
+class TrajectoryRecorder {
+public:
+    static constexpr uint32_t FRAMES_PER_CHUNK = 60;
+
+private:
+    struct SeenIncident {
+        uint32_t generation = 0;   // 0: slot not live
+        IncidentState state = INCIDENT_PENDING;
+        float x = 0.0f, y = 0.0f;
+    };
+
+    TrajectoryWriter writer;
+    std::vector<uint8_t> chunk;
+    uint32_t chunkFrames = 0;
+    std::vector<uint8_t> lightRed;
+    std::vector<SeenIncident> seen;         // per incident slot
+    std::vector<TrajectoryEvent> events;
+    unsigned long long frames = 0;
+
+    template <class T> void Append(std::vector<uint8_t>& out, const T* data, size_t count) {
+        size_t at = out.size();
+        out.resize(at + sizeof(T) * count);
+        if (count) memcpy(&out[at], data, sizeof(T) * count);
+    }
+
+    void BeginChunk() {
+        TrajectoryChunkHeader header = { { 'C', 'H', 'N', 'K' }, 0, 0, 0 };
+        Append(chunk, &header, 1);
+        Append(chunk, lightRed.data(), lightRed.size());
+        chunk.resize((chunk.size() + 3) & ~(size_t)3, 0);
+        for (uint32_t slot = 0; slot < seen.size(); slot++) {
+            if (seen[slot].generation == 0) continue;
+            TrajectoryIncident inc = { slot, (uint8_t)seen[slot].state, { 0, 0, 0 }, seen[slot].x, seen[slot].y };
+            Append(chunk, &inc, 1);
+            header.incidentCount++;
+        }
+        memcpy(&chunk[0], &header, sizeof(header));
+    }
+
+    void FinishChunk() {
+        TrajectoryChunkHeader header;
+        memcpy(&header, &chunk[0], sizeof(header));
+        header.byteSize = (uint32_t)chunk.size();
+        header.frameCount = chunkFrames;
+        memcpy(&chunk[0], &header, sizeof(header));
+        writer.Write(chunk);
+        chunkFrames = 0;
+    }
+
+    void CollectEvents(const Simulation& sim) {
+        events.clear();
+        size_t light = 0;
+        for (int k = 0; k < sim.RoadCount(); k++) {
+            for (const TrafficLight& l : sim.GetRoad(k).lights) {
+                uint8_t red = l.IsRed() ? 1 : 0;
+                if (red != lightRed[light]) {
+                    events.push_back({ TRAJ_EVENT_SIGNAL, (uint8_t)k, (uint16_t)light, red, l.GetX(), l.GetY() });
+                    lightRed[light] = red;
+                }
+                light++;
+            }
+        }
+
+        const IncidentTable& table = sim.GetIncidents();
+        if (seen.size() < table.SlotCount()) seen.resize(table.SlotCount());
+        for (uint32_t slot = 0; slot < table.SlotCount(); slot++) {
+            SeenIncident& was = seen[slot];
+            uint32_t generation = table.IsLive(slot) ? table.HandleAt(slot).generation : 0;
+            if (was.generation != 0 && was.generation != generation) {
+                events.push_back({ TRAJ_EVENT_INCIDENT_CLOSED, 0, 0, slot, was.x, was.y });
+                was = SeenIncident();
+            }
+            if (generation == 0) continue;
+            const Incident& inc = table.At(slot);
+            if (was.generation == generation && was.state == inc.state) continue;
+            was.generation = generation;
+            was.state = inc.state;
+            was.x = inc.x; was.y = inc.y;
+            events.push_back({ TRAJ_EVENT_INCIDENT, 0, (uint16_t)inc.state, slot, inc.x, inc.y });
+        }
+    }
+
+public:
+    bool Open(const char* path, const Simulation& sim, uint64_t seed) {
+        if (!writer.Open(path)) return false;
+        const WorldConfig& cfg = sim.GetConfig();
+        std::vector<uint8_t> head;
+        std::vector<TrajectoryLight> lights;
+        for (int k = 0; k < sim.RoadCount(); k++) {
+            for (const TrafficLight& l : sim.GetRoad(k).lights) {
+                lights.push_back({ l.GetX(), l.GetY(), (uint16_t)k, 0 });
+                lightRed.push_back(l.IsRed() ? 1 : 0);
+            }
+        }
+        TrajectoryFileHeader header = { { 'T', 'R', 'T', 'J' }, TRAJECTORY_VERSION, seed, cfg.worldWidth,
+                                         (uint32_t)cfg.roads.size(), (uint32_t)lights.size(), 0 };
+        Append(head, &header, 1);
+        for (const RoadConfig& r : cfg.roads) {
+            TrajectoryRoad road = { r.y, (uint8_t)r.lanes, (uint8_t)r.dirRight, (uint8_t)r.incidents, 0 };
+            Append(head, &road, 1);
+        }
+        Append(head, lights.data(), lights.size());
+        writer.Write(head);
+        return true;
+    }
+
+    bool IsOpen() const { return writer.IsOpen(); }
+
+    void Capture(const Simulation& sim) {
+        PROFILE_SCOPE("sim.trajectory");
+        if (chunkFrames == 0) BeginChunk();
+        CollectEvents(sim);
+
+        TrajectoryFrameHeader frame = { sim.GetTick(), (uint32_t)sim.VehicleCount(), (uint32_t)events.size(), 0 };
+        Append(chunk, &frame, 1);
+        size_t at = chunk.size();
+        chunk.resize(at + sizeof(TrajectoryVehicle) * frame.vehicleCount);
+        TrajectoryVehicle* out = reinterpret_cast<TrajectoryVehicle*>(&chunk[at]);
+        for (int k = 0; k < sim.RoadCount(); k++) {
+            const VehicleStore& s = sim.GetRoad(k).vehicles;
+            for (uint32_t i = 0; i < s.Size(); i++, out++) {
+                VehicleHandle h = s.HandleOf(i);
+                *out = TrajectoryVehicle{ h.slot, h.generation, s.x[i], s.y[i], s.speed[i], s.color[i], s.flags[i],
+                                          s.type[i], (uint8_t)k, s.sprite[i], { 0, 0, 0 } };
+            }
+        }
+        Append(chunk, events.data(), events.size());
+
+        frames++;
+        if (++chunkFrames == FRAMES_PER_CHUNK) FinishChunk();
+    }
+
+    // Writes out the partial chunk and waits for the writer; false on any write error
+    bool Close() {
+        if (!writer.IsOpen()) return true;
+        if (chunkFrames > 0) FinishChunk();
+        return writer.Close();
+    }
+
+    unsigned long long FrameCount() const { return frames; }
+    unsigned long long BytesWritten() const { return writer.BytesWritten(); }
+};
+
+// --- PLAYBACK ---
+// Read-only view of a recording. The file is memory-mapped (read whole on
+// Windows); opening it walks the chunk headers once to index every frame.
+class TrajectoryFile {
+public:
+    struct Frame {
+        uint32_t tick;
+        const TrajectoryVehicle* vehicles;
+        uint32_t vehicleCount;
+        const TrajectoryEvent* events;
+        uint32_t eventCount;
+    };
+
+private:
+    MappedFile file;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    TrajectoryFileHeader header{};
+    const TrajectoryRoad* roads = nullptr;
+    const TrajectoryLight* lights = nullptr;
+    std::vector<size_t> frameOffset;
+    std::vector<uint32_t> frameChunk;       // frame -> index into chunkOffset
+    std::vector<size_t> chunkOffset;
+
+    bool Fail(std::string& error, const char* path, const char* what) {
+        error = std::string(path) + ": " + what;
+        Close();
+        return false;
+    }
+
+    bool Map(const char* path) {
+        if (!file.Open(path)) return false;
+        data = file.Data();
+        size = file.Size();
+        return true;
+    }
+
+    // Frame headers are walked in order; the chunk's declared size bounds them
+    bool IndexChunk(size_t at, size_t end) {
+        TrajectoryChunkHeader ch;
+        memcpy(&ch, data + at, sizeof(ch));
+        size_t pos = at + sizeof(ch) + ((header.lightCount + 3) & ~(size_t)3) + sizeof(TrajectoryIncident) * (size_t)ch.incidentCount;
+        uint32_t chunk = (uint32_t)chunkOffset.size();
+        for (uint32_t f = 0; f < ch.frameCount; f++) {
+            if (pos + sizeof(TrajectoryFrameHeader) > end) return false;
+            TrajectoryFrameHeader fh;
+            memcpy(&fh, data + pos, sizeof(fh));
+            size_t bytes = sizeof(fh) + sizeof(TrajectoryVehicle) * (size_t)fh.vehicleCount + sizeof(TrajectoryEvent) * (size_t)fh.eventCount;
+            if (pos + bytes > end) return false;
+            frameOffset.push_back(pos);
+            frameChunk.push_back(chunk);
+            pos += bytes;
+        }
+        chunkOffset.push_back(at);
+        return true;
+    }
+
+public:
+    TrajectoryFile() = default;
+    TrajectoryFile(const TrajectoryFile&) = delete;
+    TrajectoryFile& operator=(const TrajectoryFile&) = delete;
+    ~TrajectoryFile() { Close(); }
+
+    bool Open(const char* path, std::string& error) {
+        Close();
+        if (!Map(path)) return Fail(error, path, "cannot read the file");
+        if (size < sizeof(header)) return Fail(error, path, "not a trajectory recording");
+        memcpy(&header, data, sizeof(header));
+        if (memcmp(header.magic, "TRTJ", 4) != 0) return Fail(error, path, "not a trajectory recording");
+        if (header.version != TRAJECTORY_VERSION) return Fail(error, path, "unsupported trajectory version");
+        size_t pos = sizeof(header) + sizeof(TrajectoryRoad) * (size_t)header.roadCount + sizeof(TrajectoryLight) * (size_t)header.lightCount;
+        if (pos > size) return Fail(error, path, "truncated header");
+        roads = (const TrajectoryRoad*)(data + sizeof(header));
+        lights = (const TrajectoryLight*)(roads + header.roadCount);
+
+        while (pos + sizeof(TrajectoryChunkHeader) <= size) {
+            TrajectoryChunkHeader ch;
+            memcpy(&ch, data + pos, sizeof(ch));
+            if (memcmp(ch.magic, "CHNK", 4) != 0 || ch.byteSize < sizeof(ch) || pos + ch.byteSize > size) break;
+            size_t frames = frameOffset.size();
+            if (!IndexChunk(pos, pos + ch.byteSize)) {
+                frameOffset.resize(frames);
+                frameChunk.resize(frames);
+                break;
+            }
+            pos += ch.byteSize;
+        }
+        return true;
+    }
+
+    void Close() {
+        file.Close();
+        data = nullptr;
+        size = 0;
+        frameOffset.clear(); frameChunk.clear(); chunkOffset.clear();
+    }
+
+    const TrajectoryFileHeader& Header() const { return header; }
+    const TrajectoryRoad& Road(uint32_t k) const { return roads[k]; }
+    const TrajectoryLight& Light(uint32_t k) const { return lights[k]; }
+    size_t FrameCount() const { return frameOffset.size(); }
+    size_t Bytes() const { return size; }
+
+    Frame FrameAt(size_t k) const {
+        TrajectoryFrameHeader fh;
+        memcpy(&fh, data + frameOffset[k], sizeof(fh));
+        const uint8_t* p = data + frameOffset[k] + sizeof(fh);
+        const TrajectoryVehicle* vehicles = (const TrajectoryVehicle*)p;
+        return Frame{ fh.tick, vehicles, fh.vehicleCount, (const TrajectoryEvent*)(vehicles + fh.vehicleCount), fh.eventCount };
+    }
+
+    // Light states (1 = red) and live incidents as of the end of frame k
+    void StateAt(size_t k, std::vector<uint8_t>& lightRed, std::vector<TrajectoryIncident>& incidents) const {
+        size_t at = chunkOffset[frameChunk[k]];
+        TrajectoryChunkHeader ch;
+        memcpy(&ch, data + at, sizeof(ch));
+        const uint8_t* p = data + at + sizeof(ch);
+        lightRed.assign(p, p + header.lightCount);
+        const TrajectoryIncident* inc = (const TrajectoryIncident*)(p + ((header.lightCount + 3) & ~(size_t)3));
+        incidents.assign(inc, inc + ch.incidentCount);
+
+        size_t first = k;
+        while (first > 0 && frameChunk[first - 1] == frameChunk[k]) first--;
+        for (size_t f = first; f <= k; f++) {
+            Frame frame = FrameAt(f);
+            for (uint32_t e = 0; e < frame.eventCount; e++) {
+                const TrajectoryEvent& ev = frame.events[e];
+                if (ev.kind == TRAJ_EVENT_SIGNAL) { if (ev.index < lightRed.size()) lightRed[ev.index] = (uint8_t)ev.id; continue; }
+                size_t n = 0;
+                while (n < incidents.size() && incidents[n].slot != ev.id) n++;
+                if (ev.kind == TRAJ_EVENT_INCIDENT_CLOSED) { if (n < incidents.size()) incidents.erase(incidents.begin() + n); continue; }
+                if (n == incidents.size()) incidents.push_back(TrajectoryIncident{ ev.id, 0, { 0, 0, 0 }, 0.0f, 0.0f });
+                incidents[n].state = (uint8_t)ev.index;
+                incidents[n].x = ev.x; incidents[n].y = ev.y;
+            }
+        }
+    }
+};
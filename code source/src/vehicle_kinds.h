@@ -0,0 +1,58 @@
+#pragma once
+// What each kind of vehicle does differently when deciding whether to
+// stop, fixed at compile time. The decide pass switches on a vehicle's
+// kind once and then runs code built for that kind, so the scans over its
+// neighbours carry no type checks of their own. How a vehicle is treated
+// as a leader depends only on the leader's kind and whether it moves, and
+// comes from a table the simulation fills once from GapBehind().
+//
+// A new kind needs a VehicleType, a KindPolicy here and a case in ForKind().
+
+#include <cstdint>
+#include "vehicle_store.h"
+#include "world_config.h"
+
+// Gap an ambulance keeps to anything ahead of it, whatever its kind
+constexpr float CLOSE_FOLLOW_GAP = 10.0f;
+
+template <VehicleType K> struct KindPolicy;
+
+template <> struct KindPolicy<VEHICLE_CAR> {
+    static constexpr bool STOPS_AT_LIGHTS = true;
+    static constexpr bool PASSES_WRECKS = false;    // drives on past crashed cars in its lane
+    static constexpr bool CLOSE_FOLLOW = false;     // keeps CLOSE_FOLLOW_GAP instead of the leader's gap
+    static float GapBehind(const WorldConfig& cfg, bool) { return cfg.safeDistance; }
+};
+
+template <> struct KindPolicy<VEHICLE_AMBULANCE> {
+    static constexpr bool STOPS_AT_LIGHTS = false;
+    static constexpr bool PASSES_WRECKS = false;
+    static constexpr bool CLOSE_FOLLOW = true;
+    // Stopped at a scene it needs room to load
+    static float GapBehind(const WorldConfig& cfg, bool moving) { return moving ? cfg.safeDistance : 150.0f; }
+};
+
+template <> struct KindPolicy<VEHICLE_DEPANNAGE> {
+    static constexpr bool STOPS_AT_LIGHTS = true;
+    static constexpr bool PASSES_WRECKS = true;
+    static constexpr bool CLOSE_FOLLOW = false;
+    // Nothing follows close behind a load on a tow bar
+    static float GapBehind(const WorldConfig&, bool) { return 250.0f; }
+};
+
+template <> struct KindPolicy<VEHICLE_SCHOOL_BUS> {
+    static constexpr bool STOPS_AT_LIGHTS = true;
+    static constexpr bool PASSES_WRECKS = false;
+    static constexpr bool CLOSE_FOLLOW = false;
+    static float GapBehind(const WorldConfig& cfg, bool) { return cfg.safeDistance; }
+};
+
+// Calls fn with the KindPolicy of `type`; unknown kinds behave as cars
+template <class F> auto ForKind(uint8_t type, F&& fn) -> decltype(fn(KindPolicy<VEHICLE_CAR>())) {
+    switch (type) {
+        case VEHICLE_AMBULANCE: return fn(KindPolicy<VEHICLE_AMBULANCE>());
+        case VEHICLE_DEPANNAGE: return fn(KindPolicy<VEHICLE_DEPANNAGE>());
+        case VEHICLE_SCHOOL_BUS: return fn(KindPolicy<VEHICLE_SCHOOL_BUS>());
+        default: return fn(KindPolicy<VEHICLE_CAR>());
+    }
+}
@@ -0,0 +1,168 @@
+#pragma once
+// Structure-of-arrays storage for the vehicles of one carriageway. Every
+// per-vehicle field is its own contiguous column, indexed by a dense index
+// in [0, Size()). Removing a vehicle swaps the last one into its place, so
+// dense indices are not stable; code that needs to hold on to a vehicle
+// keeps a VehicleHandle and resolves it when it needs the data.
+//
+// The store is a fixed-capacity pool: Reserve() sizes every column up
+// front, slots are recycled through a free list, and Add() refuses new
+// vehicles once the pool is full instead of growing it. Spawning and
+// despawning therefore never touch the heap after Reserve().
+
+#include <cstdint>
+#include <vector>
+
+enum VehicleType : uint8_t {
+    VEHICLE_CAR, VEHICLE_AMBULANCE, VEHICLE_DEPANNAGE, VEHICLE_SCHOOL_BUS,
+    VEHICLE_KIND_COUNT
+};
+
+// Per-vehicle state bits, packed into one uint16_t column
+enum VehicleFlag : uint16_t {
+    VF_MOVING          = 1 << 0,
+    VF_DIR_RIGHT       = 1 << 1,
+    VF_CHANGED_LANE    = 1 << 2,
+    VF_FORCED_STOP     = 1 << 3,
+    VF_CRASHED         = 1 << 4,
+    VF_TO_BE_REMOVED   = 1 << 5,
+    VF_RECKLESS        = 1 << 6,
+    VF_ACCIDENT_TARGET = 1 << 7,
+    VF_TOWED           = 1 << 8,
+    VF_LANE_LOCK       = 1 << 9,
+};
+
+struct Tint { unsigned char r, g, b, a; };
+
+// Slot plus generation. A slot's generation is bumped every time its
+// vehicle is removed, so stale handles stop resolving instead of pointing
+// at whatever reused the slot. Generation 0 is never issued.
+struct VehicleHandle {
+    uint32_t slot = 0;
+    uint32_t generation = 0;
+    bool IsNull() const { return generation == 0; }
+    bool operator==(const VehicleHandle& o) const { return slot == o.slot && generation == o.generation; }
+    bool operator!=(const VehicleHandle& o) const { return !(*this == o); }
+};
+
+class VehicleStore {
+public:
+    std::vector<float> x, y, targetY, speed, towOffsetX;
+    std::vector<float> prevX, prevY;            // position at the start of the tick, for interpolation
+    std::vector<uint16_t> flags;
+    std::vector<uint8_t> type, sprite;
+    std::vector<Tint> color;
+    std::vector<VehicleHandle> tower;
+    std::vector<int32_t> laneIndex, laneSlot;   // owned by LaneIndex
+
+private:
+    std::vector<uint32_t> denseSlot;        // dense index -> slot
+    std::vector<uint32_t> slotDense;        // slot -> dense index
+    std::vector<uint32_t> slotGeneration;
+    std::vector<uint32_t> freeSlots;
+    uint32_t capacity = 0;                  // 0: not reserved, grows on demand
+    uint32_t highWater = 0;
+
+    template <class T> static void MoveLast(std::vector<T>& column, uint32_t to) {
+        column[to] = column.back();
+        column.pop_back();
+    }
+
+public:
+    uint32_t Size() const { return (uint32_t)x.size(); }
+    uint32_t Capacity() const { return capacity; }
+    uint32_t HighWater() const { return highWater; }
+    bool Full() const { return capacity > 0 && Size() >= capacity; }
+
+    // Allocates every column for n vehicles and caps the pool there
+    void Reserve(uint32_t n) {
+        capacity = n;
+        x.reserve(n); y.reserve(n); targetY.reserve(n); speed.reserve(n); towOffsetX.reserve(n);
+        prevX.reserve(n); prevY.reserve(n);
+        flags.reserve(n); type.reserve(n); sprite.reserve(n); color.reserve(n);
+        tower.reserve(n); laneIndex.reserve(n); laneSlot.reserve(n);
+        denseSlot.reserve(n); slotDense.reserve(n); slotGeneration.reserve(n); freeSlots.reserve(n);
+    }
+
+    // Null handle when the pool is full
+    VehicleHandle Add(VehicleType kind, int spr, float startX, float startY, float spd, Tint col, bool dirRight) {
+        if (Full()) return VehicleHandle{};
+        uint32_t slot;
+        if (!freeSlots.empty()) { slot = freeSlots.back(); freeSlots.pop_back(); }
+        else { slot = (uint32_t)slotDense.size(); slotDense.push_back(0); slotGeneration.push_back(1); }
+
+        uint32_t i = Size();
+        x.push_back(startX); y.push_back(startY); targetY.push_back(startY); speed.push_back(spd); towOffsetX.push_back(0.0f);
+        prevX.push_back(startX); prevY.push_back(startY);
+        flags.push_back((uint16_t)(VF_MOVING | (dirRight ? VF_DIR_RIGHT : 0)));
+        type.push_back(kind); sprite.push_back((uint8_t)spr); color.push_back(col);
+        tower.push_back(VehicleHandle{});
+        laneIndex.push_back(-1); laneSlot.push_back(-1);
+        denseSlot.push_back(slot);
+        slotDense[slot] = i;
+        if (Size() > highWater) highWater = Size();
+        return VehicleHandle{ slot, slotGeneration[slot] };
+    }
+
+    // Removes dense index i by moving the last vehicle into its place.
+    // Returns true if a vehicle was moved (it now lives at index i).
+    bool RemoveAt(uint32_t i) {
+        uint32_t slot = denseSlot[i];
+        if (++slotGeneration[slot] == 0) slotGeneration[slot] = 1;
+        freeSlots.push_back(slot);
+
+        uint32_t last = Size() - 1;
+        MoveLast(x, i); MoveLast(y, i); MoveLast(targetY, i); MoveLast(speed, i); MoveLast(towOffsetX, i);
+        MoveLast(prevX, i); MoveLast(prevY, i);
+        MoveLast(flags, i); MoveLast(type, i); MoveLast(sprite, i); MoveLast(color, i);
+        MoveLast(tower, i); MoveLast(laneIndex, i); MoveLast(laneSlot, i);
+        MoveLast(denseSlot, i);
+        if (i == last) return false;
+        slotDense[denseSlot[i]] = i;
+        return true;
+    }
+
+    VehicleHandle HandleOf(uint32_t i) const { return VehicleHandle{ denseSlot[i], slotGeneration[denseSlot[i]] }; }
+
+    // Looks up the dense index of a live vehicle; false for null or stale handles
+    bool Resolve(VehicleHandle h, uint32_t& i) const {
+        if (h.IsNull() || h.slot >= slotGeneration.size() || slotGeneration[h.slot] != h.generation) return false;
+        i = slotDense[h.slot];
+        return true;
+    }
+
+    void SavePrevious() {
+        prevX = x;
+        prevY = y;
+    }
+
+    // Columns and slot tables in and out of a snapshot. The capacity is the
+    // world's, not the snapshot's; a snapshot that does not fit is refused.
+    template <class A> void Transfer(A& ar) {
+        uint32_t limit = capacity ? capacity : UINT32_MAX;
+        ar.Array(x, limit); ar.Array(y, limit); ar.Array(targetY, limit); ar.Array(speed, limit); ar.Array(towOffsetX, limit);
+        ar.Array(prevX, limit); ar.Array(prevY, limit);
+        ar.Array(flags, limit); ar.Array(type, limit); ar.Array(sprite, limit); ar.Array(color, limit);
+        ar.Array(tower, limit); ar.Array(laneIndex, limit); ar.Array(laneSlot, limit);
+        ar.Array(denseSlot, limit); ar.Array(slotDense, limit); ar.Array(slotGeneration, limit); ar.Array(freeSlots, limit);
+        ar.Value(highWater);
+        if (A::LOADING) ar.Check(Consistent(), "snapshot vehicle tables do not agree");
+    }
+
+    bool Consistent() const {
+        size_t n = x.size();
+        for (size_t c : { y.size(), targetY.size(), speed.size(), towOffsetX.size(), prevX.size(), prevY.size(), flags.size(),
+                          type.size(), sprite.size(), color.size(), tower.size(), laneIndex.size(), laneSlot.size(), denseSlot.size() }) {
+            if (c != n) return false;
+        }
+        if (slotGeneration.size() != slotDense.size() || n + freeSlots.size() != slotDense.size()) return false;
+        for (uint32_t i = 0; i < n; i++) if (denseSlot[i] >= slotDense.size() || slotDense[denseSlot[i]] != i) return false;
+        for (uint32_t slot : freeSlots) if (slot >= slotDense.size()) return false;
+        return true;
+    }
+
+    bool Has(uint32_t i, uint16_t flag) const { return (flags[i] & flag) != 0; }
+    void Set(uint32_t i, uint16_t flag, bool on) {
+        if (on) flags[i] = (uint16_t)(flags[i] | flag); else flags[i] = (uint16_t)(flags[i] & ~flag);
+    }
+};
@@ -0,0 +1,280 @@
+#pragma once
+// Layout and tuning of the simulated world: how many roads there are,
+// where, how many lanes each, their signals, and the vehicle parameters.
+// WorldConfig() is the original two-road, three-lane map; LoadWorldConfig
+// overrides it from a JSON file (see config.json at the repository root)
+// and rejects anything the model cannot run with a message naming the
+// offending field.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "json.h"
+
+// --- DIMENSIONS ---
+constexpr int SCREEN_WIDTH = 1600;
+constexpr int SCREEN_HEIGHT = 700;
+constexpr int WORLD_WIDTH = 4000;
+
+constexpr int ROAD_HEIGHT = 140;
+constexpr int LANE_HEIGHT = 45;
+constexpr float VEHICLE_WIDTH = 90.0f;
+constexpr float VEHICLE_HEIGHT = 40.0f;
+constexpr float SAFE_DISTANCE = 45.0f;
+constexpr int ROAD_Y_TOP = 110;
+constexpr int ROAD_Y_BOTTOM = 280;
+constexpr int LANE_COUNT = 3;
+constexpr float LANE_INSET = 10.0f;     // from a road's top edge to its first lane
+
+constexpr int MAX_ROADS = 64;
+constexpr int MAX_LANES = 32;
+
+struct SignalConfig {
+    float x, y;
+    float cycleTime;
+};
+
+struct RoadConfig {
+    float y = 0.0f;                     // top edge of the asphalt
+    int lanes = LANE_COUNT;
+    bool dirRight = true;
+    bool incidents = false;             // accidents, ambulances, tows and buses run here
+    std::vector<SignalConfig> signals;
+};
+
+struct WorldConfig {
+    float worldWidth = WORLD_WIDTH;
+    float laneHeight = LANE_HEIGHT;
+    float safeDistance = SAFE_DISTANCE;
+    int roadCapacity = 4096;               // vehicles one road can hold; spawns past it are dropped
+    float lightCycle = 5.0f;
+
+    float carMinSpeed = 2.0f, carMaxSpeed = 2.5f;
+    float spawnMinDelay = 4.0f, spawnMaxDelay = 7.0f;
+    float ambulanceSpeed = 4.5f, ambulanceWaitAtAccident = 5.0f, ambulanceWaitAtHospital = 5.0f;
+    float towSpeed = 2.5f, towWorkTime = 2.0f;
+    float busSpeed = 2.5f, busStopTime = 4.0f;
+    int maxAccidents = 1;                  // incidents under way at once, pending to cleared
+    int accidentPerMille = 5;              // chance each tick of staging a random accident, in thousandths
+    float hospitalX = 80.0f;
+    float schoolX = WORLD_WIDTH / 2 + 100.0f;
+
+    std::vector<RoadConfig> roads;
+
+    WorldConfig() {
+        RoadConfig top;
+        top.y = ROAD_Y_TOP; top.dirRight = true;
+        top.signals.push_back({ WORLD_WIDTH / 2 - 80.0f, ROAD_Y_TOP - 100.0f, lightCycle });
+        RoadConfig bottom;
+        bottom.y = ROAD_Y_BOTTOM; bottom.dirRight = false; bottom.incidents = true;
+        bottom.signals.push_back({ WORLD_WIDTH / 2 - 150.0f, ROAD_Y_BOTTOM + ROAD_HEIGHT + 20.0f, lightCycle });
+        roads.push_back(top);
+        roads.push_back(bottom);
+    }
+
+    float RoadHeight(const RoadConfig& road) const {
+        return LANE_INSET + (road.lanes - 1) * laneHeight + VEHICLE_HEIGHT;
+    }
+
+    int IncidentRoad() const {
+        for (size_t k = 0; k < roads.size(); k++) if (roads[k].incidents) return (int)k;
+        return -1;
+    }
+
+    // FNV-1a over every setting, so a snapshot can tell whether it was
+    // taken in the same world it is being loaded into
+    uint64_t Fingerprint() const {
+        uint64_t h = 1469598103934665603ULL;
+        auto mix = [&](const void* data, size_t n) {
+            const unsigned char* p = (const unsigned char*)data;
+            for (size_t k = 0; k < n; k++) { h ^= p[k]; h *= 1099511628211ULL; }
+        };
+        const float tuning[] = { worldWidth, laneHeight, safeDistance, lightCycle, carMinSpeed, carMaxSpeed,
+                                 spawnMinDelay, spawnMaxDelay, ambulanceSpeed, ambulanceWaitAtAccident, ambulanceWaitAtHospital,
+                                 towSpeed, towWorkTime, busSpeed, busStopTime, hospitalX, schoolX };
+        mix(tuning, sizeof(tuning));
+        mix(&roadCapacity, sizeof(roadCapacity));
+        mix(&maxAccidents, sizeof(maxAccidents));
+        mix(&accidentPerMille, sizeof(accidentPerMille));
+        for (const RoadConfig& road : roads) {
+            uint8_t flags[2] = { (uint8_t)road.dirRight, (uint8_t)road.incidents };
+            uint32_t signals = (uint32_t)road.signals.size();
+            mix(&road.y, sizeof(road.y)); mix(&road.lanes, sizeof(road.lanes)); mix(flags, sizeof(flags)); mix(&signals, sizeof(signals));
+            for (const SignalConfig& sig : road.signals) { mix(&sig.x, sizeof(float)); mix(&sig.y, sizeof(float)); mix(&sig.cycleTime, sizeof(float)); }
+        }
+        return h;
+    }
+};
+
+// Reads one JSON document into a WorldConfig. Fields that are absent keep
+// their current value; fields that are present must be valid.
+class WorldConfigReader {
+private:
+    std::string& error;
+
+    bool Fail(const std::string& path, const char* what) {
+        error = path + ": " + what;
+        return false;
+    }
+
+    bool Object(const JsonValue& parent, const char* key, const std::string& path, const JsonValue*& out) {
+        out = parent.Find(key);
+        if (out && !out->IsObject()) return Fail(path + key, "expected an object");
+        return true;
+    }
+
+    bool Number(const JsonValue* obj, const char* key, const std::string& path, float& out, double min, double max) {
+        const JsonValue* v = obj ? obj->Find(key) : nullptr;
+        if (!v) return true;
+        if (!v->IsNumber()) return Fail(path + key, "expected a number");
+        if (!(v->number >= min && v->number <= max)) {
+            char buf[96];
+            snprintf(buf, sizeof(buf), "%g is out of range [%g, %g]", v->number, min, max);
+            return Fail(path + key, buf);
+        }
+        out = (float)v->number;
+        return true;
+    }
+
+    bool Integer(const JsonValue* obj, const char* key, const std::string& path, int& out, int min, int max) {
+        const JsonValue* v = obj ? obj->Find(key) : nullptr;
+        if (!v) return true;
+        if (!v->IsNumber() || v->number != std::floor(v->number)) return Fail(path + key, "expected an integer");
+        if (v->number < min || v->number > max) {
+            char buf[96];
+            snprintf(buf, sizeof(buf), "%g is out of range [%d, %d]", v->number, min, max);
+            return Fail(path + key, buf);
+        }
+        out = (int)v->number;
+        return true;
+    }
+
+    bool Road(const JsonValue& v, const std::string& path, WorldConfig& cfg, RoadConfig& road) {
+        if (!v.IsObject()) return Fail(path, "expected an object");
+        if (!v.Find("y")) return Fail(path + ".y", "required");
+        if (!Number(&v, "y", path + ".", road.y, -1e6, 1e6)) return false;
+        if (!Integer(&v, "lanes", path + ".", road.lanes, 1, MAX_LANES)) return false;
+
+        if (const JsonValue* dir = v.Find("direction")) {
+            if (!dir->IsString() || (dir->text != "right" && dir->text != "left")) return Fail(path + ".direction", "expected \"right\" or \"left\"");
+            road.dirRight = dir->text == "right";
+        }
+        if (const JsonValue* inc = v.Find("incidents")) {
+            if (!inc->IsBool()) return Fail(path + ".incidents", "expected true or false");
+            road.incidents = inc->boolean;
+        }
+
+        road.signals.clear();
+        if (const JsonValue* signals = v.Find("signals")) {
+            if (!signals->IsArray()) return Fail(path + ".signals", "expected an array");
+            for (size_t k = 0; k < signals->items.size(); k++) {
+                const JsonValue& s = signals->items[k];
+                std::string sp = path + ".signals[" + std::to_string(k) + "]";
+                if (!s.IsObject()) return Fail(sp, "expected an object");
+                if (!s.Find("x")) return Fail(sp + ".x", "required");
+                // Signals sit beside the kerb the traffic keeps to unless placed explicitly
+                SignalConfig signal = { 0.0f, road.dirRight ? road.y - 100.0f : road.y + cfg.RoadHeight(road) + 20.0f, cfg.lightCycle };
+                if (!Number(&s, "x", sp + ".", signal.x, 0.0, cfg.worldWidth)) return false;
+                if (!Number(&s, "y", sp + ".", signal.y, -1e6, 1e6)) return false;
+                if (!Number(&s, "cycleTime", sp + ".", signal.cycleTime, 0.1, 3600.0)) return false;
+                road.signals.push_back(signal);
+            }
+        }
+        return true;
+    }
+
+public:
+    explicit WorldConfigReader(std::string& err) : error(err) {}
+
+    bool Read(const JsonValue& doc, WorldConfig& cfg) {
+        if (!doc.IsObject()) return Fail("document", "expected an object");
+        const JsonValue *world, *road, *light, *vehicles, *spawn, *accidents;
+        if (!Object(doc, "world", "", world) || !Object(doc, "road", "", road) || !Object(doc, "trafficLight", "", light)
+            || !Object(doc, "vehicles", "", vehicles) || !Object(doc, "spawn", "", spawn) || !Object(doc, "accidents", "", accidents)) return false;
+
+        if (!Number(world, "width", "world.", cfg.worldWidth, 500.0, 1e7)) return false;
+        cfg.schoolX = cfg.worldWidth / 2 + 100.0f;
+        if (!Number(world, "hospitalX", "world.", cfg.hospitalX, 0.0, cfg.worldWidth)) return false;
+        if (!Number(world, "schoolX", "world.", cfg.schoolX, 0.0, cfg.worldWidth)) return false;
+
+        if (!Number(road, "laneHeight", "road.", cfg.laneHeight, VEHICLE_HEIGHT, 500.0)) return false;
+        if (!Number(road, "safeDistance", "road.", cfg.safeDistance, 0.0, 1000.0)) return false;
+        if (!Integer(road, "capacity", "road.", cfg.roadCapacity, 16, 1 << 22)) return false;
+        if (!Number(light, "cycleTime", "trafficLight.", cfg.lightCycle, 0.1, 3600.0)) return false;
+
+        const JsonValue *car = nullptr, *ambulance = nullptr, *tow = nullptr, *bus = nullptr;
+        if (vehicles && (!Object(*vehicles, "car", "vehicles.", car) || !Object(*vehicles, "ambulance", "vehicles.", ambulance)
+            || !Object(*vehicles, "towTruck", "vehicles.", tow) || !Object(*vehicles, "schoolBus", "vehicles.", bus))) return false;
+        if (!Number(car, "minSpeed", "vehicles.car.", cfg.carMinSpeed, 0.1, 100.0)) return false;
+        if (!Number(car, "maxSpeed", "vehicles.car.", cfg.carMaxSpeed, 0.1, 100.0)) return false;
+        if (cfg.carMaxSpeed < cfg.carMinSpeed) return Fail("vehicles.car.maxSpeed", "must not be below minSpeed");
+        if (!Number(ambulance, "speed", "vehicles.ambulance.", cfg.ambulanceSpeed, 0.1, 100.0)) return false;
+        if (!Number(ambulance, "waitAtAccident", "vehicles.ambulance.", cfg.ambulanceWaitAtAccident, 0.0, 3600.0)) return false;
+        if (!Number(ambulance, "waitAtHospital", "vehicles.ambulance.", cfg.ambulanceWaitAtHospital, 0.0, 3600.0)) return false;
+        if (!Number(tow, "speed", "vehicles.towTruck.", cfg.towSpeed, 0.1, 100.0)) return false;
+        if (!Number(tow, "workTime", "vehicles.towTruck.", cfg.towWorkTime, 0.0, 3600.0)) return false;
+        if (!Number(bus, "speed", "vehicles.schoolBus.", cfg.busSpeed, 0.1, 100.0)) return false;
+        if (!Number(bus, "stopTime", "vehicles.schoolBus.", cfg.busStopTime, 0.0, 3600.0)) return false;
+
+        if (!Number(spawn, "minDelay", "spawn.", cfg.spawnMinDelay, 0.1, 3600.0)) return false;
+        if (!Number(spawn, "maxDelay", "spawn.", cfg.spawnMaxDelay, 0.1, 3600.0)) return false;
+        if (cfg.spawnMaxDelay < cfg.spawnMinDelay) return Fail("spawn.maxDelay", "must not be below minDelay");
+        if (!Integer(accidents, "maxConcurrent", "accidents.", cfg.maxAccidents, 1, 4096)) return false;
+        if (!Integer(accidents, "perMille", "accidents.", cfg.accidentPerMille, 0, 1000)) return false;
+
+        if (const JsonValue* roads = doc.Find("roads")) {
+            if (!roads->IsArray()) return Fail("roads", "expected an array");
+            if (roads->items.empty() || roads->items.size() > (size_t)MAX_ROADS) return Fail("roads", "expected between 1 and 64 roads");
+            cfg.roads.clear();
+            for (size_t k = 0; k < roads->items.size(); k++) {
+                RoadConfig r;
+                if (!Road(roads->items[k], "roads[" + std::to_string(k) + "]", cfg, r)) return false;
+                cfg.roads.push_back(r);
+            }
+        } else {
+            // Without a roads array the default layout follows the new lane height and cycle
+            for (RoadConfig& r : cfg.roads) for (SignalConfig& s : r.signals) s.cycleTime = cfg.lightCycle;
+        }
+        return Validate(cfg);
+    }
+
+    // Cross-field checks that apply however the config was built
+    bool Validate(const WorldConfig& cfg) {
+        int incidentRoads = 0;
+        for (size_t k = 0; k < cfg.roads.size(); k++) {
+            if (!cfg.roads[k].incidents) continue;
+            incidentRoads++;
+            std::string path = "roads[" + std::to_string(k) + "]";
+            // The ambulance, tow and bus routes all head for the hospital at the left end
+            if (cfg.roads[k].dirRight) return Fail(path + ".direction", "the incidents road must run \"left\"");
+        }
+        if (incidentRoads != 1) return Fail("roads", "exactly one road must set \"incidents\": true");
+
+        for (size_t a = 0; a < cfg.roads.size(); a++) {
+            for (size_t b = a + 1; b < cfg.roads.size(); b++) {
+                const RoadConfig& ra = cfg.roads[a];
+                const RoadConfig& rb = cfg.roads[b];
+                if (ra.y < rb.y + cfg.RoadHeight(rb) && rb.y < ra.y + cfg.RoadHeight(ra)) {
+                    return Fail("roads[" + std::to_string(b) + "]", ("overlaps roads[" + std::to_string(a) + "]").c_str());
+                }
+            }
+        }
+        return true;
+    }
+};
+
+inline bool ParseWorldConfig(const std::string& text, WorldConfig& cfg, std::string& error) {
+    JsonValue doc;
+    if (!ParseJson(text, doc, error)) return false;
+    WorldConfigReader reader(error);
+    return reader.Read(doc, cfg);
+}
+
+inline bool LoadWorldConfig(const char* path, WorldConfig& cfg, std::string& error) {
+    std::string text;
+    if (!ReadTextFile(path, text)) { error = std::string("cannot read ") + path; return false; }
+    if (!ParseWorldConfig(text, cfg, error)) { error = std::string(path) + ": " + error; return false; }
+    return true;
+}